@@ -1,107 +1,918 @@
 #version 430 core
 
+// Dimension of the simulation, injected by ComputeShader from SIM_DIM
+#ifndef DIM
+#define DIM 2
+#endif
+
+// Hot record, read and written by every pass (24 bytes in 2D, 32 bytes in 3D)
+#if DIM == 2
+#define vecN vec2
 struct Particle
 {
-    uint id;           
-    float radius;      
-    float mass;        
-    float _padding1;
-
-    vec3 pos;          
-    float _padding2;   
-    vec3 vel;          
-    float _padding3;   
-    vec3 acc;          
-    float _padding4;   
+    vec2 pos;
+    vec2 vel;
+    float radius;
+    float mass;
+};
+#else
+#define vecN vec3
+struct Particle
+{
+    vec3 pos;
+    float radius;
+    vec3 vel;
+    float mass;
+};
+#endif
 
-    vec3 p_pos;        
-    float _padding5;   
-    vec3 p_vel;        
-    float _padding6;   
-    vec3 p_acc;        
-    float _padding7;   
+// Cold record, parallel to the particles (80 bytes)
+struct ParticleAttributes
+{
+    vec4 color;
+    vec3 acc;
+    uint id;
 
-    vec4 color;        
+    vec3 p_pos;
+    uint hasPast;           // 1 when the past fields hold the last step of a Verlet integrator
+    vec3 p_vel;
+    float _padding2;
+    vec3 p_acc;
+    float _padding3;
 };
 
-layout(local_size_x = 128, local_size_y = 1, local_size_z = 1) in;
+// Passes of one simulation step, dispatched in this order by ComputeShader::Update
+#define PASS_INTEGRATE        0     // integrate, wall collision, count particles per cell
+#define PASS_SCAN_BLOCKS      1     // exclusive prefix sum of the cell counts per workgroup
+#define PASS_SCAN_BLOCK_SUMS  2     // exclusive prefix sum of the workgroup totals (single workgroup)
+#define PASS_SCAN_ADD         3     // add the workgroup offsets to the cell offsets
+#define PASS_SCATTER          4     // counting sort of the particle indices by cell into scatterIndex
+#define PASS_SORT_CELLS       5     // place every particle at its index rank within its cell, the scatter order depends on scheduling
+#define PASS_COLLIDE          6     // particle collisions against the neighbouring cells into collisions[]
+#define PASS_APPLY_COLLISIONS 7     // apply collisions[], write the render stream
+
+// Passes of the particle mesh, dispatched before PASS_INTEGRATE in FORCE_PARTICLE_MESH
+#define PASS_MESH_CLEAR             8   // zero the mass per cell
+#define PASS_MESH_DEPOSIT           9   // cloud-in-cell deposit of the particle masses
+#define PASS_MESH_ROWS              10  // real-to-complex transform along x, one workgroup per row
+#define PASS_MESH_COLUMNS           11  // transform along y (3D only), one workgroup per column
+#define PASS_MESH_CONVOLVE          12  // transform along the last axis, multiply by the Green's function, transform back
+#define PASS_MESH_INVERSE_COLUMNS   13  // inverse transform along y (3D only)
+#define PASS_MESH_INVERSE_ROWS      14  // complex-to-real transform along x, write the potential
+
+// Pass of FORCE_ALL_PAIRS, dispatched before PASS_INTEGRATE
+#define PASS_ALL_PAIRS              15  // gravity of all particles per particle, in tiles through shared memory
 
-layout(std430, binding = 0) buffer DataBuffer 
+// Pass of the Morton reorder, dispatched before the first step of an update by ComputeShader::Update
+#define PASS_PERMUTE                16  // gather the particles in the order uploaded into sortedIndex
+
+// Integration schemes, must match the Integrator enum in SimConfig.h
+#define INTEGRATOR_EULER            0
+#define INTEGRATOR_POSITION_VERLET  1
+#define INTEGRATOR_VELOCITY_VERLET  2
+
+// Forces between the particles, must match the ForceMode enum in SimConfig.h
+#define FORCE_NONE          0
+#define FORCE_BARNES_HUT    1
+#define FORCE_PARTICLE_MESH 2
+#define FORCE_ALL_PAIRS     3
+
+// Force mode of this variant, injected by ComputeShader
+#ifndef FORCE_MODE
+#define FORCE_MODE FORCE_NONE
+#endif
+
+// Cells per axis of the particle mesh, a power of two, injected by ComputeShader
+#ifndef PM_GRID
+#define PM_GRID 256
+#endif
+
+// Invocations per workgroup, injected by ComputeShader
+#ifndef WORKGROUP_SIZE
+#define WORKGROUP_SIZE 128
+#endif
+
+layout(local_size_x = WORKGROUP_SIZE, local_size_y = 1, local_size_z = 1) in;
+
+layout(std430, binding = 0) buffer DataBuffer
 {
     Particle particles[];
 };
 
-uniform float deltaTime;
+layout(std430, binding = 1) buffer AttributeBuffer
+{
+    ParticleAttributes attributes[];
+};
+
+layout(std430, binding = 2) buffer CellCountBuffer
+{
+    uint cellCount[];       // particles per cell, back to zero after PASS_SCATTER
+};
+
+layout(std430, binding = 3) buffer CellStartBuffer
+{
+    uint cellStart[];       // index of the first particle of a cell in sortedIndex
+};
+
+layout(std430, binding = 4) buffer SortedIndexBuffer
+{
+    uint sortedIndex[];     // particle indices ordered by cell and by index within a cell, the old index of every particle in PASS_PERMUTE
+};
+
+layout(std430, binding = 13) buffer ScatterIndexBuffer
+{
+    uint scatterIndex[];    // particle indices ordered by cell, in the order of the atomics of PASS_SCATTER
+};
+
+layout(std430, binding = 5) buffer BlockSumBuffer
+{
+    uint blockSum[];        // cell count total per workgroup of PASS_SCAN_BLOCKS
+};
+
+// Result of the collisions of a particle, PASS_COLLIDE only reads the particles (32 bytes)
+struct Collision
+{
+    vec4 correction;        // xyz added to the position
+    vec4 vel;               // xyz velocity after the collisions
+};
+
+layout(std430, binding = 10) buffer CollisionBuffer
+{
+    Collision collisions[];
+};
+
+// Spare particle buffers of PASS_PERMUTE, they take the place of the particle buffers afterwards
+layout(std430, binding = 11) writeonly buffer PermutedDataBuffer
+{
+    Particle permutedParticles[];
+};
+
+layout(std430, binding = 12) writeonly buffer PermutedAttributeBuffer
+{
+    ParticleAttributes permutedAttributes[];
+};
+
+layout(std430, binding = 6) writeonly buffer RenderBuffer
+{
+    uint renderStream[];    // 3 per particle: half float xy position, half float radius, RGBA8 color
+};
+
+#if FORCE_MODE == FORCE_BARNES_HUT
+// Node of the Barnes-Hut tree built by BarnesHutTree, depth first (48 bytes)
+struct GravityNode
+{
+    vec4 massCenter;        // xyz center of mass, w total mass
+    vec4 cell;              // xyz center of the cell, w half its edge length
+    uint next;              // first node after the subtree of this node
+    uint first;             // first body of a leaf in gravityBodies
+    uint count;             // bodies of a leaf, 0 for an internal node
+    uint _padding;
+};
+
+layout(std430, binding = 8) readonly buffer GravityNodeBuffer
+{
+    GravityNode gravityNodes[];
+};
+
+layout(std430, binding = 9) readonly buffer GravityBodyBuffer
+{
+    vec4 gravityBodies[];   // position and mass at the start of the steps, in tree order
+};
+
+layout(std430, binding = 14) readonly buffer GravityOwnerBuffer
+{
+    uint gravityOwners[];   // particle index of every body
+};
+#endif
+
+#if FORCE_MODE == FORCE_PARTICLE_MESH
+// Grid of ParticleMesh, the transforms run on a grid padded to MESH_PADDED cells per axis
+const uint MESH_CELLS = uint(PM_GRID);
+const uint MESH_PADDED = 2u * MESH_CELLS;
+const uint MESH_FREQUENCIES = MESH_CELLS + 1u;     // non negative frequencies along x of a padded row
+#if DIM == 2
+const uint MESH_GRID_CELLS = MESH_CELLS * MESH_CELLS;
+const uint MESH_SPECTRUM = MESH_FREQUENCIES * MESH_PADDED;
+#else
+const uint MESH_GRID_CELLS = MESH_CELLS * MESH_CELLS * MESH_CELLS;
+const uint MESH_SPECTRUM = MESH_FREQUENCIES * MESH_PADDED * MESH_PADDED;
+#endif
+
+layout(std430, binding = 8) buffer MeshGridBuffer
+{
+    uint meshGrid[];        // float bits per cell, x fastest: the mass until PASS_MESH_INVERSE_ROWS, then the potential
+};
+
+layout(std430, binding = 9) buffer MeshSpectrumBuffer
+{
+    vec2 meshSpectrum[];    // MESH_SPECTRUM of the padded grid, then MESH_SPECTRUM of the Green's function (real)
+};
+#endif
+
+#if FORCE_MODE == FORCE_ALL_PAIRS
+layout(std430, binding = 8) buffer PairForceBuffer
+{
+    vec4 pairForces[];      // xyz gravity of the other particles per particle, written by PASS_ALL_PAIRS
+};
+#endif
+
+// Parameters of the simulation step, written once per update, must match SimParams in SimConfig.h
+layout(std140, binding = 0) uniform SimParamsBlock
+{
+    vec4 screenMin;         // lower corner of the walls, 960 x 540 screen
+    vec4 screenMax;         // upper corner of the walls
+    vec4 gravity;           // added to the acceleration of every particle
+
+    vec2 gridMin;
+    ivec2 gridDim;
+
+    float deltaTime;
+    float cellSize;
+    float frictionW;        // velocity kept after bouncing off a wall
+    float frictionP;        // velocity kept after a particle collision
+
+    uint particleCount;
+    int integrator;
+    float gravityConstant;  // G of the mutual gravity
+    float softening;        // added to the distance of the mutual gravity as sqrt(r^2 + softening^2)
+
+    float openingAngle;     // cells smaller than openingAngle times their distance are not opened
+    float pmCellSize;       // cell size of the particle mesh, its grid starts at screenMin
+};
+
+uniform int pass;
+uniform bool resetPast;     // ignore the past fields, set for the first step after a change of integrator
+uniform bool writeRenderStream;     // only the last of several steps per frame writes the render stream
+
+shared uint s_Scan[gl_WorkGroupSize.x];
+#if FORCE_MODE == FORCE_PARTICLE_MESH
+shared vec2 s_Fft[MESH_PADDED];
+#elif FORCE_MODE == FORCE_ALL_PAIRS
+shared vec4 s_Tile[gl_WorkGroupSize.x];
+#endif
+
+vec3 Widen(vecN v)
+{
+#if DIM == 2
+    return vec3(v, 0.0);
+#else
+    return v;
+#endif
+}
+
+#if FORCE_MODE == FORCE_BARNES_HUT
+// Walk the tree without a stack, same as BarnesHutTree::Acceleration
+// The bodies are those of the first of the steps, so the own body is skipped by index
+vec3 BarnesHutAcceleration(vec3 pos, uint self)
+{
+    vec3 acc = vec3(0.0);
+    float softening2 = softening * softening;
+    float theta2 = openingAngle * openingAngle;
+
+    uint n = 0u;
+    uint nodeCount = uint(gravityNodes.length());
+    while (n < nodeCount)
+    {
+        vec4 massCenter = gravityNodes[n].massCenter;
+        vec4 cell = gravityNodes[n].cell;
+        vec3 d = massCenter.xyz - pos;
+        float r2 = dot(d, d);
+        float edge = 2.0 * cell.w;
+        bool inside = all(lessThanEqual(abs(pos - cell.xyz), vec3(cell.w)));
+
+        if (!inside && edge * edge < theta2 * r2)
+        {
+            float inverse = inversesqrt(r2 + softening2);
+            acc += massCenter.w * d * inverse * inverse * inverse;
+            n = gravityNodes[n].next;
+        }
+        else if (gravityNodes[n].count > 0u)
+        {
+            uint first = gravityNodes[n].first;
+            uint last = first + gravityNodes[n].count;
+            for (uint k = first; k < last; ++k)
+            {
+                vec3 body = gravityBodies[k].xyz - pos;
+                float bodyR2 = dot(body, body);
+                if (gravityOwners[k] != self && bodyR2 > 0.0)
+                {
+                    float inverse = inversesqrt(bodyR2 + softening2);
+                    acc += gravityBodies[k].w * body * inverse * inverse * inverse;
+                }
+            }
+            n = gravityNodes[n].next;
+        }
+        else
+        {
+            n++;
+        }
+    }
+    return gravityConstant * acc;
+}
+#endif
+
+#if FORCE_MODE == FORCE_PARTICLE_MESH
+const float PI = 3.14159265358979;
+
+vec2 ComplexMul(vec2 a, vec2 b)
+{
+    return vec2(a.x * b.x - a.y * b.y, a.x * b.y + a.y * b.x);
+}
+
+vec2 Conj(vec2 a)
+{
+    return vec2(a.x, -a.y);
+}
+
+// In place transform of the first n points of s_Fft, same as Fft::Transform
+void FftShared(uint n, bool inverse, uint lid)
+{
+    uint bits = uint(findMSB(n));
+    for (uint j = lid; j < n; j += gl_WorkGroupSize.x)
+    {
+        uint r = bitfieldReverse(j) >> (32u - bits);
+        if (j < r)
+        {
+            vec2 swap = s_Fft[j];
+            s_Fft[j] = s_Fft[r];
+            s_Fft[r] = swap;
+        }
+    }
+    barrier();
+
+    float sign = inverse ? 1.0 : -1.0;
+    for (uint span = 1u; span < n; span <<= 1)
+    {
+        for (uint t = lid; t < n / 2u; t += gl_WorkGroupSize.x)
+        {
+            uint k = t & (span - 1u);
+            uint a = 2u * t - k;
+            float angle = sign * PI * float(k) / float(span);
+            vec2 u = s_Fft[a];
+            vec2 v = ComplexMul(s_Fft[a + span], vec2(cos(angle), sin(angle)));
+            s_Fft[a] = u + v;
+            s_Fft[a + span] = u - v;
+        }
+        barrier();
+    }
+
+    if (inverse)
+    {
+        for (uint j = lid; j < n; j += gl_WorkGroupSize.x)
+            s_Fft[j] /= float(n);
+        barrier();
+    }
+}
+
+uint MeshIndex(ivec3 cell)
+{
+    return (uint(cell.z) * MESH_CELLS + uint(cell.y)) * MESH_CELLS + uint(cell.x);
+}
+
+// Cloud-in-cell stencil of a position, same as ParticleMesh::CloudInCell
+void MeshCloudInCell(vec3 pos, out ivec3 first, out vec3 fraction)
+{
+    vec3 u = clamp((pos - screenMin.xyz) / pmCellSize - 0.5, vec3(0.0), vec3(float(MESH_CELLS - 1u)));
+    first = min(ivec3(floor(u)), ivec3(int(MESH_CELLS) - 2));
+    fraction = u - vec3(first);
+#if DIM == 2
+    first.z = 0;
+    fraction.z = 0.0;
+#endif
+}
+
+ivec3 MeshCornerOffset(uint corner)
+{
+    return ivec3(uvec3(corner, corner >> 1, corner >> 2) & 1u);
+}
+
+float MeshCornerWeight(ivec3 offset, vec3 fraction)
+{
+    vec3 weight = mix(1.0 - fraction, fraction, vec3(offset));
+#if DIM == 2
+    return weight.x * weight.y;
+#else
+    return weight.x * weight.y * weight.z;
+#endif
+}
+
+// Add to a cell of the mass, the float add is a compare and swap loop
+void MeshAtomicAdd(uint cell, float value)
+{
+    uint expected = meshGrid[cell];
+    while (true)
+    {
+        uint previous = atomicCompSwap(meshGrid[cell], expected, floatBitsToUint(uintBitsToFloat(expected) + value));
+        if (previous == expected)
+            break;
+        expected = previous;
+    }
+}
+
+void MeshDeposit(uint i)
+{
+    ivec3 first;
+    vec3 fraction;
+    MeshCloudInCell(Widen(particles[i].pos), first, fraction);
+    for (uint corner = 0u; corner < (1u << DIM); corner++)
+    {
+        ivec3 offset = MeshCornerOffset(corner);
+        MeshAtomicAdd(MeshIndex(first + offset), particles[i].mass * MeshCornerWeight(offset, fraction));
+    }
+}
+
+// Real-to-complex transform of a row of the mass along x, same as Fft::RealForward
+void MeshRows(uint row, uint lid)
+{
+    uint y = row % MESH_CELLS;
+    uint z = row / MESH_CELLS;
+    uint source = row * MESH_CELLS;
+    for (uint n = lid; n < MESH_CELLS; n += gl_WorkGroupSize.x)
+    {
+        s_Fft[n] = n < MESH_CELLS / 2u
+            ? vec2(uintBitsToFloat(meshGrid[source + 2u * n]), uintBitsToFloat(meshGrid[source + 2u * n + 1u]))
+            : vec2(0.0);
+    }
+    barrier();
+    FftShared(MESH_CELLS, false, lid);
 
-// 960 x 540
-vec3 screenMin = {-0.5, -0.5, 0.0};  // Minimum screen bounds ({0.0, 0.0, 0.0})
-vec3 screenMax = {800.0, 600.0, 0.0};
+    uint target = (z * MESH_PADDED + y) * MESH_FREQUENCIES;
+    for (uint k = lid; k <= MESH_CELLS; k += gl_WorkGroupSize.x)
+    {
+        vec2 a = s_Fft[k % MESH_CELLS];
+        vec2 b = Conj(s_Fft[(MESH_CELLS - k) % MESH_CELLS]);
+        vec2 even = 0.5 * (a + b);
+        vec2 odd = ComplexMul(vec2(0.0, -0.5), a - b);
+        float angle = -PI * float(k) / float(MESH_CELLS);
+        meshSpectrum[target + k] = even + ComplexMul(vec2(cos(angle), sin(angle)), odd);
+    }
+}
 
-//vec3 screenMin = {-100.0, -100.0, 0.0};
-//vec3 screenMax = {600.0, 400.0, 0.0};
+// Complex-to-real transform of a row along x into the potential, same as Fft::RealInverse
+void MeshInverseRows(uint row, uint lid)
+{
+    uint y = row % MESH_CELLS;
+    uint z = row / MESH_CELLS;
+    uint source = (z * MESH_PADDED + y) * MESH_FREQUENCIES;
+    for (uint k = lid; k < MESH_CELLS; k += gl_WorkGroupSize.x)
+    {
+        vec2 a = meshSpectrum[source + k];
+        vec2 b = Conj(meshSpectrum[source + MESH_CELLS - k]);
+        vec2 even = 0.5 * (a + b);
+        float angle = PI * float(k) / float(MESH_CELLS);
+        vec2 odd = ComplexMul(0.5 * (a - b), vec2(cos(angle), sin(angle)));
+        s_Fft[k] = even + ComplexMul(vec2(0.0, 1.0), odd);
+    }
+    barrier();
+    FftShared(MESH_CELLS, true, lid);
 
-//uniform vec3 screenMin;  // Minimum screen bounds (e.g., {0.0, 0.0, 0.0})
-//uniform vec3 screenMax;
+    uint target = row * MESH_CELLS;
+    for (uint n = lid; n < MESH_CELLS / 2u; n += gl_WorkGroupSize.x)
+    {
+        meshGrid[target + 2u * n] = floatBitsToUint(s_Fft[n].x);
+        meshGrid[target + 2u * n + 1u] = floatBitsToUint(s_Fft[n].y);
+    }
+}
 
-float frictionW = 0.95;
-float frictionP = 0.96;
+// Load the points of a column of the spectrum, the points from valid on are zero
+void MeshLoadColumn(uint base, uint stride, uint valid, uint lid)
+{
+    for (uint k = lid; k < MESH_PADDED; k += gl_WorkGroupSize.x)
+        s_Fft[k] = k < valid ? meshSpectrum[base + k * stride] : vec2(0.0);
+    barrier();
+}
+
+void MeshStoreColumn(uint base, uint stride, uint valid, uint lid)
+{
+    for (uint k = lid; k < valid; k += gl_WorkGroupSize.x)
+        meshSpectrum[base + k * stride] = s_Fft[k];
+}
+
+// Column along y of the planes z < MESH_CELLS, the only ones with mass
+uint MeshColumnBase(uint column)
+{
+    return (column / MESH_FREQUENCIES) * MESH_PADDED * MESH_FREQUENCIES + column % MESH_FREQUENCIES;
+}
+
+// Transform a column along the last axis, multiply by the Green's function and transform back
+void MeshConvolve(uint column, uint lid)
+{
+    uint stride = MESH_SPECTRUM / MESH_PADDED;
+    MeshLoadColumn(column, stride, MESH_CELLS, lid);
+    FftShared(MESH_PADDED, false, lid);
+    for (uint k = lid; k < MESH_PADDED; k += gl_WorkGroupSize.x)
+        s_Fft[k] *= meshSpectrum[MESH_SPECTRUM + column + k * stride].x;
+    barrier();
+    FftShared(MESH_PADDED, true, lid);
+    MeshStoreColumn(column, stride, MESH_CELLS, lid);
+}
+
+float MeshPotential(ivec3 cell)
+{
+    return uintBitsToFloat(meshGrid[MeshIndex(cell)]);
+}
+
+// Central differences of the potential, same as ParticleMesh::Gradient
+vec3 MeshGradient(ivec3 cell)
+{
+    vec3 gradient = vec3(0.0);
+    for (int axis = 0; axis < DIM; axis++)
+    {
+        ivec3 lo = cell;
+        ivec3 hi = cell;
+        lo[axis] = max(cell[axis] - 1, 0);
+        hi[axis] = min(cell[axis] + 1, int(MESH_CELLS) - 1);
+        gradient[axis] = (MeshPotential(hi) - MeshPotential(lo)) / (float(hi[axis] - lo[axis]) * pmCellSize);
+    }
+    return gradient;
+}
+
+// Interpolate the gradient of the potential, same as ParticleMesh::Acceleration
+vec3 ParticleMeshAcceleration(vec3 pos)
+{
+    ivec3 first;
+    vec3 fraction;
+    MeshCloudInCell(pos, first, fraction);
+
+    vec3 gradient = vec3(0.0);
+    for (uint corner = 0u; corner < (1u << DIM); corner++)
+    {
+        ivec3 offset = MeshCornerOffset(corner);
+        gradient += MeshCornerWeight(offset, fraction) * MeshGradient(first + offset);
+    }
+    return -gravityConstant * gradient;
+}
+#endif
+
+#if FORCE_MODE == FORCE_ALL_PAIRS
+// Gravity of all particles on particle i. The workgroup loads a tile of positions and
+// masses into shared memory, every invocation reads the whole tile from there, so every
+// particle is read from the ssbo once per workgroup instead of once per invocation.
+void AllPairs(uint i, uint lid)
+{
+    vec3 pos = i < particleCount ? Widen(particles[i].pos) : vec3(0.0);
+    vec3 acc = vec3(0.0);
+    float softening2 = softening * softening;
+
+    for (uint tile = 0u; tile < particleCount; tile += gl_WorkGroupSize.x)
+    {
+        uint j = tile + lid;
+        s_Tile[lid] = j < particleCount ? vec4(Widen(particles[j].pos), particles[j].mass) : vec4(0.0);
+        barrier();
+
+        for (uint k = 0u; k < gl_WorkGroupSize.x; k++)
+        {
+            vec3 d = s_Tile[k].xyz - pos;
+            float r2 = dot(d, d);
+            float inverse = r2 > 0.0 ? inversesqrt(r2 + softening2) : 0.0;
+            acc += s_Tile[k].w * d * inverse * inverse * inverse;
+        }
+        barrier();
+    }
+
+    if (i < particleCount)
+        pairForces[i] = vec4(gravityConstant * acc, 0.0);
+}
+#endif
+
+// Acceleration of the particle, its own acceleration, the gravity and the forces of the other particles
+vec3 Acceleration(uint i)
+{
+    vec3 acc = attributes[i].acc + gravity.xyz;
+#if FORCE_MODE == FORCE_BARNES_HUT
+    acc += BarnesHutAcceleration(Widen(particles[i].pos), i);
+#elif FORCE_MODE == FORCE_PARTICLE_MESH
+    acc += ParticleMeshAcceleration(Widen(particles[i].pos));
+#elif FORCE_MODE == FORCE_ALL_PAIRS
+    acc += pairForces[i].xyz;
+#endif
+    return acc;
+}
 
 void Update(uint i)
 {
-    particles[i].pos = particles[i].pos + particles[i].vel * deltaTime + ((particles[i].acc * deltaTime * deltaTime)/2);
-    particles[i].vel = particles[i].acc * deltaTime + particles[i].vel;
+    if (deltaTime <= 0.0)
+        return;
+
+    vec3 total = Acceleration(i);
+    vecN acc = vecN(total);
+    bool hasPast = attributes[i].hasPast != 0u && !resetPast;
+
+    if (integrator == INTEGRATOR_POSITION_VERLET)
+    {
+        // the past position is written after the collisions, see SavePastPosition
+        vecN current = particles[i].pos;
+        vecN previous = hasPast ? vecN(attributes[i].p_pos) : current - particles[i].vel * deltaTime;
+        particles[i].pos = 2.0 * current - previous + acc * deltaTime * deltaTime;
+        particles[i].vel = (particles[i].pos - current) / deltaTime;
+    }
+    else if (integrator == INTEGRATOR_VELOCITY_VERLET)
+    {
+        // finish the velocity of the last step with the acceleration at the current position
+        if (hasPast)
+            particles[i].vel += 0.5 * (vecN(attributes[i].p_acc) + acc) * deltaTime;
+        particles[i].pos = particles[i].pos + particles[i].vel * deltaTime + ((acc * deltaTime * deltaTime)/2);
+        attributes[i].p_acc = total;
+        attributes[i].hasPast = 1u;
+    }
+    else
+    {
+        particles[i].pos = particles[i].pos + particles[i].vel * deltaTime + ((acc * deltaTime * deltaTime)/2);
+        particles[i].vel = acc * deltaTime + particles[i].vel;
+    }
+}
+
+// Position Verlet keeps the velocity in the past position, rebuild it after the wall and particle collisions changed the velocity
+void SavePastPosition(uint i)
+{
+    if (integrator != INTEGRATOR_POSITION_VERLET || deltaTime <= 0.0)
+        return;
+
+    attributes[i].p_pos = Widen(particles[i].pos - particles[i].vel * deltaTime);
+    attributes[i].hasPast = 1u;
 }
 
 void CheckCollisionWall(uint i)
 {
-    if (particles[i].pos.x - particles[i].radius < screenMin.x || particles[i].pos.x + particles[i].radius > screenMax.x) 
+    if (particles[i].pos.x - particles[i].radius < screenMin.x || particles[i].pos.x + particles[i].radius > screenMax.x)
     {
-        particles[i].vel.x = -particles[i].vel.x * frictionW; 
+        particles[i].vel.x = -particles[i].vel.x * frictionW;
         particles[i].pos.x = clamp(particles[i].pos.x, screenMin.x + particles[i].radius, screenMax.x - particles[i].radius);
     }
 
-    if (particles[i].pos.y - particles[i].radius < screenMin.y || particles[i].pos.y + particles[i].radius > screenMax.y) 
+    if (particles[i].pos.y - particles[i].radius < screenMin.y || particles[i].pos.y + particles[i].radius > screenMax.y)
     {
-        particles[i].vel.y = -particles[i].vel.y * frictionW; 
+        particles[i].vel.y = -particles[i].vel.y * frictionW;
         particles[i].pos.y = clamp(particles[i].pos.y, screenMin.y + particles[i].radius, screenMax.y - particles[i].radius);
     }
 
-    if (particles[i].pos.z - particles[i].radius < screenMin.z || particles[i].pos.z + particles[i].radius > screenMax.z) 
+#if DIM == 3
+    if (particles[i].pos.z - particles[i].radius < screenMin.z || particles[i].pos.z + particles[i].radius > screenMax.z)
     {
-        particles[i].vel.z = -particles[i].vel.z * frictionW; 
+        particles[i].vel.z = -particles[i].vel.z * frictionW;
         particles[i].pos.z = clamp(particles[i].pos.z, screenMin.z + particles[i].radius, screenMax.z - particles[i].radius);
     }
+#endif
+}
+
+ivec2 CellCoord(vecN pos)
+{
+    return clamp(ivec2(floor((pos.xy - gridMin) / cellSize)), ivec2(0), gridDim - 1);
+}
+
+uint CellIndex(ivec2 cell)
+{
+    return uint(cell.y * gridDim.x + cell.x);
+}
+
+uint CellTotal()
+{
+    return uint(gridDim.x * gridDim.y);
+}
+
+/**
+ * Inclusive Hillis-Steele scan of s_Scan over the workgroup.
+ * Must be reached by every invocation of the workgroup.
+ */
+void ScanShared(uint lid)
+{
+    for (uint offset = 1u; offset < gl_WorkGroupSize.x; offset <<= 1u)
+    {
+        uint value = lid >= offset ? s_Scan[lid - offset] : 0u;
+        barrier();
+        s_Scan[lid] += value;
+        barrier();
+    }
 }
 
-void CheckCollionParticlesSimple(uint i)
+void ScanBlocks(uint c, uint lid)
 {
-    for (uint j = 0; j < particles.length(); ++j)
+    uint count = c < CellTotal() ? cellCount[c] : 0u;
+    s_Scan[lid] = count;
+    barrier();
+
+    ScanShared(lid);
+
+    if (c < CellTotal())
+        cellStart[c] = s_Scan[lid] - count;
+    if (lid == gl_WorkGroupSize.x - 1u)
+        blockSum[gl_WorkGroupID.x] = s_Scan[lid];
+}
+
+void ScanBlockSums(uint lid)
+{
+    uint blockCount = (CellTotal() + gl_WorkGroupSize.x - 1u) / gl_WorkGroupSize.x;
+    uint perInvocation = (blockCount + gl_WorkGroupSize.x - 1u) / gl_WorkGroupSize.x;
+    uint begin = min(lid * perInvocation, blockCount);
+    uint end = min(begin + perInvocation, blockCount);
+
+    uint sum = 0u;
+    for (uint b = begin; b < end; ++b)
+        sum += blockSum[b];
+
+    s_Scan[lid] = sum;
+    barrier();
+
+    ScanShared(lid);
+
+    uint running = s_Scan[lid] - sum;
+    for (uint b = begin; b < end; ++b)
     {
-        if (i != j) 
+        uint value = blockSum[b];
+        blockSum[b] = running;
+        running += value;
+    }
+}
+
+// Place particle i in sortedIndex at the number of particles with a lower index in its cell,
+// so the neighbours are visited in the same order every run. Every particle of a cell counts
+// in parallel, the reads per particle are those of one cell of PASS_COLLIDE.
+void SortCell(uint i)
+{
+    uint c = CellIndex(CellCoord(particles[i].pos));
+    uint begin = cellStart[c];
+    uint end = c + 1u < CellTotal() ? cellStart[c + 1u] : particleCount;
+
+    uint rank = 0u;
+    for (uint k = begin; k < end; ++k)
+    {
+        if (scatterIndex[k] < i)
+            ++rank;
+    }
+    sortedIndex[begin + rank] = i;
+}
+
+// Gather the collisions of particle i against the positions at the start of the pass,
+// only collisions[i] is written, so the result does not depend on the scheduling
+void CheckCollisionParticlesGrid(uint i)
+{
+    vecN pos = particles[i].pos;
+    vecN vel = particles[i].vel;
+    vecN correction = vecN(0.0);
+    ivec2 cell = CellCoord(pos);
+
+    for (int dy = -1; dy <= 1; ++dy)
+    {
+        for (int dx = -1; dx <= 1; ++dx)
         {
-            vec3 diff = particles[i].pos - particles[j].pos;
-            float distance = length(diff);
-            float collisionDistance = particles[i].radius + particles[j].radius;
+            ivec2 neighbour = cell + ivec2(dx, dy);
+            if (any(lessThan(neighbour, ivec2(0))) || any(greaterThanEqual(neighbour, gridDim)))
+                continue;
+
+            uint n = CellIndex(neighbour);
+            uint end = n + 1u < CellTotal() ? cellStart[n + 1u] : particleCount;
 
-            if (distance < collisionDistance) 
+            for (uint k = cellStart[n]; k < end; ++k)
             {
-                vec3 normal = normalize(diff);
-                particles[i].vel = reflect(particles[i].vel, normal) * frictionP;
-                particles[j].vel = reflect(particles[j].vel, -normal) * frictionP;
+                uint j = sortedIndex[k];
+                if (i == j)
+                    continue;
+
+                vecN diff = pos - particles[j].pos;
+                float distance = length(diff);
+                float collisionDistance = particles[i].radius + particles[j].radius;
+
+                if (distance < collisionDistance && distance > 0.0)
+                {
+                    vecN normal = diff / distance;
+                    vel = reflect(vel, normal) * frictionP;
 
-                float overlap = 0.5 * (collisionDistance - distance);
-                particles[i].pos += normal * overlap;
-                particles[j].pos -= normal * overlap;
+                    float overlap = 0.5 * (collisionDistance - distance);
+                    correction += normal * overlap;
+                }
             }
         }
     }
+
+    collisions[i].correction = vec4(Widen(correction), 0.0);
+    collisions[i].vel = vec4(Widen(vel), 0.0);
 }
 
-void main() 
+void ApplyCollisions(uint i)
+{
+#if DIM == 2
+    particles[i].pos += collisions[i].correction.xy;
+    particles[i].vel = collisions[i].vel.xy;
+#else
+    particles[i].pos += collisions[i].correction.xyz;
+    particles[i].vel = collisions[i].vel.xyz;
+#endif
+}
+
+// Pack what the vertex shaders need into 12 bytes
+void WriteRenderStream(uint i)
+{
+    renderStream[3u * i + 0u] = packHalf2x16(particles[i].pos.xy);
+    renderStream[3u * i + 1u] = packHalf2x16(vec2(particles[i].radius, 0.0));
+    renderStream[3u * i + 2u] = packUnorm4x8(attributes[i].color);
+}
+
+void main()
 {
     uint i = gl_GlobalInvocationID.x;
+    uint lid = gl_LocalInvocationID.x;
+
+    switch (pass)
+    {
+    case PASS_INTEGRATE:
+        if (i < particleCount)
+        {
+            Update(i);
+            CheckCollisionWall(i);
+            atomicAdd(cellCount[CellIndex(CellCoord(particles[i].pos))], 1u);
+        }
+        break;
+
+    case PASS_SCAN_BLOCKS:
+        ScanBlocks(i, lid);
+        break;
+
+    case PASS_SCAN_BLOCK_SUMS:
+        ScanBlockSums(lid);
+        break;
+
+    case PASS_SCAN_ADD:
+        if (i < CellTotal())
+            cellStart[i] += blockSum[gl_WorkGroupID.x];
+        break;
+
+    case PASS_SCATTER:
+        if (i < particleCount)
+        {
+            uint c = CellIndex(CellCoord(particles[i].pos));
+            uint remaining = atomicAdd(cellCount[c], 0xFFFFFFFFu);
+            scatterIndex[cellStart[c] + remaining - 1u] = i;
+        }
+        break;
 
-    Update(i);
-    CheckCollisionWall(i);
-    CheckCollionParticlesSimple(i);
-}
\ No newline at end of file
+    case PASS_SORT_CELLS:
+        if (i < particleCount)
+            SortCell(i);
+        break;
+
+    case PASS_COLLIDE:
+        if (i < particleCount)
+            CheckCollisionParticlesGrid(i);
+        break;
+
+    case PASS_APPLY_COLLISIONS:
+        if (i < particleCount)
+        {
+            ApplyCollisions(i);
+            SavePastPosition(i);
+            if (writeRenderStream)
+                WriteRenderStream(i);
+        }
+        break;
+
+#if FORCE_MODE == FORCE_PARTICLE_MESH
+    case PASS_MESH_CLEAR:
+        if (i < MESH_GRID_CELLS)
+            meshGrid[i] = 0u;
+        break;
+
+    case PASS_MESH_DEPOSIT:
+        if (i < particleCount)
+            MeshDeposit(i);
+        break;
+
+    case PASS_MESH_ROWS:
+        MeshRows(gl_WorkGroupID.x, lid);
+        break;
+
+    case PASS_MESH_COLUMNS:
+        MeshLoadColumn(MeshColumnBase(gl_WorkGroupID.x), MESH_FREQUENCIES, MESH_CELLS, lid);
+        FftShared(MESH_PADDED, false, lid);
+        MeshStoreColumn(MeshColumnBase(gl_WorkGroupID.x), MESH_FREQUENCIES, MESH_PADDED, lid);
+        break;
+
+    case PASS_MESH_CONVOLVE:
+        MeshConvolve(gl_WorkGroupID.x, lid);
+        break;
+
+    case PASS_MESH_INVERSE_COLUMNS:
+        MeshLoadColumn(MeshColumnBase(gl_WorkGroupID.x), MESH_FREQUENCIES, MESH_PADDED, lid);
+        FftShared(MESH_PADDED, true, lid);
+        MeshStoreColumn(MeshColumnBase(gl_WorkGroupID.x), MESH_FREQUENCIES, MESH_CELLS, lid);
+        break;
+
+    case PASS_MESH_INVERSE_ROWS:
+        MeshInverseRows(gl_WorkGroupID.x, lid);
+        break;
+#endif
+
+#if FORCE_MODE == FORCE_ALL_PAIRS
+    case PASS_ALL_PAIRS:
+        AllPairs(i, lid);
+        break;
+#endif
+
+    case PASS_PERMUTE:
+        if (i < particleCount)
+        {
+            permutedParticles[i] = particles[sortedIndex[i]];
+            permutedAttributes[i] = attributes[sortedIndex[i]];
+        }
+        break;
+    }
+}
@@ -0,0 +1,21 @@
+#version 430 core
+
+in vec4 FragmentColor;
+in vec2 LocalPosition;
+out vec4 color;
+
+uniform int pointSprite;
+
+void main()
+{
+    vec2 local = pointSprite == 1 ? gl_PointCoord * 2.0 - 1.0 : LocalPosition;
+
+    // distance to the centre, the edge is smoothed over one pixel inside the quad
+    float distance = length(local);
+    float edge = fwidth(distance);
+    float coverage = 1.0 - smoothstep(1.0 - edge, 1.0, distance);
+    if (coverage <= 0.0)
+        discard;
+
+    color = vec4(FragmentColor.rgb, FragmentColor.a * coverage);
+}
@@ -0,0 +1,35 @@
+#version 430 core
+
+layout(std430, binding = 6) readonly buffer RenderBuffer
+{
+    uint renderStream[];    // written by Compute.glsl, 3 per particle: half float xy position, half float radius, RGBA8 color
+};
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform int pointSprite;    // 1: one GL_POINTS vertex per particle, 0: 4 vertex triangle strip quad
+uniform float pointScale;   // pixels per world unit, for gl_PointSize
+
+out vec4 FragmentColor;
+out vec2 LocalPosition;     // position in the quad, the disc has radius 1
+
+void main()
+{
+    uint particleIndex = gl_InstanceID; // Instance ID determines which particle to use
+    vec3 position = vec3(unpackHalf2x16(renderStream[3u * particleIndex + 0u]), 0.0);
+    float radius = unpackHalf2x16(renderStream[3u * particleIndex + 1u]).x;
+    FragmentColor = unpackUnorm4x8(renderStream[3u * particleIndex + 2u]);
+
+    if (pointSprite == 1)
+    {
+        LocalPosition = vec2(0.0);
+        gl_PointSize = 2.0 * radius * pointScale;
+        gl_Position = projection * view * vec4(position, 1.0);
+        return;
+    }
+
+    // corners of the triangle strip: (-1,-1) (1,-1) (-1,1) (1,1)
+    LocalPosition = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+    vec3 worldPosition = position + vec3(LocalPosition * radius, 0.0);
+    gl_Position = projection * view * vec4(worldPosition, 1.0);
+}
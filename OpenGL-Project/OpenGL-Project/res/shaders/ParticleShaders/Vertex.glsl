@@ -1,32 +1,8 @@
 #version 430 core
 
-struct Particle
+layout(std430, binding = 6) readonly buffer RenderBuffer
 {
-    uint id;           
-    float radius;      
-    float mass;        
-    float _padding1;   
-
-    vec3 pos;          
-    float _padding2;   
-    vec3 vel;          
-    float _padding3;   
-    vec3 acc;          
-    float _padding4;   
-
-    vec3 p_pos;        
-    float _padding5;   
-    vec3 p_vel;        
-    float _padding6;   
-    vec3 p_acc;        
-    float _padding7;   
-
-    vec4 color;        
-};
-
-layout(std430, binding = 0) buffer DataBuffer 
-{
-    Particle particles[];
+    uint renderStream[];    // written by Compute.glsl, 3 per particle: half float xy position, half float radius, RGBA8 color
 };
 
 layout(location = 0) in vec3 quadVertex;
@@ -39,7 +15,9 @@ out vec4 FragmentColor;
 void main()
 {
     uint particleIndex = gl_InstanceID; // Instance ID determines which particle to use
-    vec3 worldPosition = particles[particleIndex].pos + quadVertex * particles[particleIndex].radius;
-    FragmentColor = particles[particleIndex].color; // Pass particle color to fragment shader
+    vec2 position = unpackHalf2x16(renderStream[3u * particleIndex + 0u]);
+    float radius = unpackHalf2x16(renderStream[3u * particleIndex + 1u]).x;
+    vec3 worldPosition = vec3(position, 0.0) + quadVertex * radius;
+    FragmentColor = unpackUnorm4x8(renderStream[3u * particleIndex + 2u]); // Pass particle color to fragment shader
     gl_Position = projection * view * vec4(worldPosition, 1.0);
 }
\ No newline at end of file
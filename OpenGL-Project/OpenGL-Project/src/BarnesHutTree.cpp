@@ -0,0 +1,373 @@
+/**
+ * @file BarnesHutTree.cpp
+ * @brief This file contains the implementation for the BarnesHutTree class.
+ *
+ * @details This file contains the method definitions for building the tree of the
+ * particle masses in parallel and walking it for the gravitational acceleration.
+ * Acceleration mirrors BarnesHutAcceleration in Compute.glsl.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "BarnesHutTree.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <mutex>
+
+#include "Particle.h"
+#include "ParticleSoA.h"
+
+constexpr unsigned int BarnesHutTree::LEAF_SIZE;
+constexpr unsigned int BarnesHutTree::BITS;
+constexpr unsigned int BarnesHutTree::TOP_LEVELS;
+constexpr unsigned int BarnesHutTree::BUCKETS;
+
+/// Children of an internal node
+static constexpr unsigned int CHILDREN = 1u << SIM_DIM;
+
+/// Center of a child cell, bit axis of digit selects the upper half of that axis
+static glm::vec3 ChildCenter(const glm::vec3& center, float half, unsigned int digit)
+{
+    glm::vec3 result = center;
+    for (int axis = 0; axis < SIM_DIM; axis++)
+        result[axis] += ((digit >> axis) & 1u) ? half / 2.0f : -half / 2.0f;
+    return result;
+}
+
+/// 1 / (r2)^1.5
+static float InverseCube(float r2)
+{
+    float inverse = 1.0f / std::sqrt(r2);
+    return inverse * inverse * inverse;
+}
+
+/**
+ * @brief Constructor
+ */
+BarnesHutTree::BarnesHutTree()
+    : m_Subtrees(BUCKETS), m_Origin(0.0f), m_Extent(1.0f)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+BarnesHutTree::~BarnesHutTree()
+{
+}
+
+/**
+ * @brief Build the tree of the masses of the particles
+ *
+ * @param particles the particles
+ * @param count number of particles
+ * @param threadPool threads to build with
+ */
+void BarnesHutTree::Build(const Particle* particles, size_t count, ThreadPool& threadPool)
+{
+    m_Bodies.resize(count);
+    threadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            m_Bodies[i] = glm::vec4(ToVec3(particles[i].m_Position), particles[i].m_Mass);
+    });
+
+    Build(threadPool);
+}
+
+/**
+ * @brief Build the tree of the masses of structure of arrays particles
+ *
+ * @param particles the particles
+ * @param threadPool threads to build with
+ */
+void BarnesHutTree::Build(const ParticleSoA& particles, ThreadPool& threadPool)
+{
+    m_Bodies.resize(particles.size());
+    threadPool.ParallelFor(particles.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            m_Bodies[i] = glm::vec4(ToVec3(particles.GetPosition(i)), particles.Mass()[i]);
+    });
+
+    Build(threadPool);
+}
+
+/**
+ * @brief Build the tree of m_Bodies
+ *
+ * @param threadPool threads to build with
+ *
+ * @details
+ * The bounding box and Morton codes are computed in parallel. MortonOrder::SortKeys
+ * splits the bodies into BUCKETS by the top bits of the codes, every bucket is one cell
+ * of level TOP_LEVELS, and sorts them. The buckets are built into subtrees in parallel,
+ * BuildTop then adds the nodes above them.
+ */
+void BarnesHutTree::Build(ThreadPool& threadPool)
+{
+    size_t count = m_Bodies.size();
+    m_Nodes.clear();
+    m_Keys.resize(count);
+    m_SortedBodies.resize(count);
+    if (count == 0)
+        return;
+
+    glm::vec3 boundsMin(FLT_MAX);
+    glm::vec3 boundsMax(-FLT_MAX);
+    std::mutex boundsMutex;
+    threadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        glm::vec3 chunkMin(FLT_MAX);
+        glm::vec3 chunkMax(-FLT_MAX);
+        for (size_t i = begin; i < end; i++)
+        {
+            chunkMin = glm::min(chunkMin, glm::vec3(m_Bodies[i]));
+            chunkMax = glm::max(chunkMax, glm::vec3(m_Bodies[i]));
+        }
+
+        std::lock_guard<std::mutex> lock(boundsMutex);
+        boundsMin = glm::min(boundsMin, chunkMin);
+        boundsMax = glm::max(boundsMax, chunkMax);
+    });
+
+    m_Origin = boundsMin;
+    m_Extent = MortonOrder::CubeExtent(boundsMin, boundsMax);     ///< 1 when every body is at the same position
+
+    // the buckets are the cells of level TOP_LEVELS, the top SIM_DIM * TOP_LEVELS bits of the code
+    MortonOrder::ComputeKeys(count, [&](size_t i) { return glm::vec3(m_Bodies[i]); }, m_Origin, m_Extent, m_Unsorted, threadPool);
+    MortonOrder::SortKeys(m_Unsorted, SIM_DIM * TOP_LEVELS, m_Keys, m_BucketStart, threadPool);
+
+    glm::vec3 rootCenter(0.0f);
+    for (int axis = 0; axis < SIM_DIM; axis++)
+        rootCenter[axis] = m_Origin[axis] + m_Extent / 2.0f;
+
+    threadPool.ParallelFor(BUCKETS, [&](size_t first, size_t last)
+    {
+        for (size_t b = first; b < last; b++)
+        {
+            unsigned int begin = m_BucketStart[b];
+            unsigned int end = m_BucketStart[b + 1];
+            m_Subtrees[b].clear();
+            if (begin == end)
+                continue;
+
+            for (unsigned int k = begin; k < end; k++)
+                m_SortedBodies[k] = m_Bodies[(uint32_t)m_Keys[k]];
+
+            glm::vec3 center = rootCenter;
+            float half = m_Extent / 2.0f;
+            for (unsigned int level = 0; level < TOP_LEVELS; level++)
+            {
+                center = ChildCenter(center, half, (unsigned int)(b >> (SIM_DIM * (TOP_LEVELS - 1 - level))) & (CHILDREN - 1));
+                half /= 2.0f;
+            }
+            BuildSubtree(m_Subtrees[b], begin, end, TOP_LEVELS, center, half);
+        }
+    });
+
+    BuildTop(0, 0, rootCenter, m_Extent / 2.0f);
+}
+
+/**
+ * @brief Build the nodes of a cell above the subtrees into m_Nodes
+ *
+ * @param prefix the digits of the cell
+ * @param level level of the cell, 0 is the root
+ * @param center center of the cell
+ * @param half half the edge length of the cell
+ *
+ * @details
+ * At level TOP_LEVELS the subtree of the bucket is appended. A cell with at most
+ * LEAF_SIZE bodies becomes a leaf, like in BuildSubtree. The cell must hold bodies.
+ */
+void BarnesHutTree::BuildTop(unsigned int prefix, unsigned int level, const glm::vec3& center, float half)
+{
+    unsigned int span = BUCKETS >> (SIM_DIM * level);
+    unsigned int begin = m_BucketStart[prefix * span];
+    unsigned int end = m_BucketStart[(prefix + 1) * span];
+
+    unsigned int index = (unsigned int)m_Nodes.size();
+    if (level == TOP_LEVELS)
+    {
+        for (GravityNode node : m_Subtrees[prefix])
+        {
+            node.next += index;
+            m_Nodes.push_back(node);
+        }
+        return;
+    }
+
+    m_Nodes.emplace_back();
+    m_Nodes[index].cell = glm::vec4(center, half);
+    if (end - begin <= LEAF_SIZE)
+    {
+        SetLeaf(m_Nodes[index], begin, end);
+    }
+    else
+    {
+        glm::vec3 moment(0.0f);
+        float mass = 0.0f;
+        for (unsigned int digit = 0; digit < CHILDREN; digit++)
+        {
+            unsigned int child = prefix * CHILDREN + digit;
+            unsigned int childSpan = span / CHILDREN;
+            if (m_BucketStart[child * childSpan] == m_BucketStart[(child + 1) * childSpan])
+                continue;
+
+            unsigned int childIndex = (unsigned int)m_Nodes.size();
+            BuildTop(child, level + 1, ChildCenter(center, half, digit), half / 2.0f);
+            moment += glm::vec3(m_Nodes[childIndex].massCenter) * m_Nodes[childIndex].massCenter.w;
+            mass += m_Nodes[childIndex].massCenter.w;
+        }
+
+        m_Nodes[index].massCenter = mass > 0.0f ? glm::vec4(moment / mass, mass) : glm::vec4(center, 0.0f);
+        m_Nodes[index].first = begin;
+        m_Nodes[index].count = 0;
+    }
+    m_Nodes[index].next = (unsigned int)m_Nodes.size();
+}
+
+/**
+ * @brief Build the nodes of a cell and everything below it
+ *
+ * @param nodes the nodes to append to
+ * @param begin first body of the cell in the tree order
+ * @param end one past the last body
+ * @param level level of the cell, 0 is the root
+ * @param center center of the cell
+ * @param half half the edge length of the cell
+ * @return unsigned int index of the node of the cell
+ *
+ * @details
+ * The next of the nodes is an index into nodes. The mass and center of mass of an
+ * internal node are summed from its children after they are built.
+ */
+unsigned int BarnesHutTree::BuildSubtree(std::vector<GravityNode>& nodes, unsigned int begin, unsigned int end, unsigned int level, const glm::vec3& center, float half) const
+{
+    unsigned int index = (unsigned int)nodes.size();
+    nodes.emplace_back();
+    nodes[index].cell = glm::vec4(center, half);
+
+    if (end - begin <= LEAF_SIZE || level == BITS)
+    {
+        SetLeaf(nodes[index], begin, end);
+    }
+    else
+    {
+        glm::vec3 moment(0.0f);
+        float mass = 0.0f;
+
+        // the bodies are sorted, so the bodies of a child are the run with the same digit
+        unsigned int childBegin = begin;
+        while (childBegin < end)
+        {
+            unsigned int digit = Digit(childBegin, level);
+            unsigned int childEnd = childBegin + 1;
+            while (childEnd < end && Digit(childEnd, level) == digit)
+                childEnd++;
+
+            unsigned int child = BuildSubtree(nodes, childBegin, childEnd, level + 1, ChildCenter(center, half, digit), half / 2.0f);
+            moment += glm::vec3(nodes[child].massCenter) * nodes[child].massCenter.w;
+            mass += nodes[child].massCenter.w;
+            childBegin = childEnd;
+        }
+
+        nodes[index].massCenter = mass > 0.0f ? glm::vec4(moment / mass, mass) : glm::vec4(center, 0.0f);
+        nodes[index].first = begin;
+        nodes[index].count = 0;
+    }
+
+    nodes[index].next = (unsigned int)nodes.size();
+    return index;
+}
+
+/**
+ * @brief Make a node a leaf of the bodies begin to end
+ */
+void BarnesHutTree::SetLeaf(GravityNode& node, unsigned int begin, unsigned int end) const
+{
+    glm::vec3 moment(0.0f);
+    float mass = 0.0f;
+    for (unsigned int k = begin; k < end; k++)
+    {
+        moment += glm::vec3(m_SortedBodies[k]) * m_SortedBodies[k].w;
+        mass += m_SortedBodies[k].w;
+    }
+
+    node.massCenter = mass > 0.0f ? glm::vec4(moment / mass, mass) : glm::vec4(glm::vec3(node.cell), 0.0f);
+    node.first = begin;
+    node.count = end - begin;
+}
+
+/**
+ * @brief Child of the cell of a level that a sorted body is in
+ *
+ * @param body index in the tree order
+ * @param level level of the cell, 0 is the root
+ * @return unsigned int SIM_DIM bits, one per axis
+ */
+unsigned int BarnesHutTree::Digit(unsigned int body, unsigned int level) const
+{
+    uint32_t code = (uint32_t)(m_Keys[body] >> 32);
+    return (code >> (SIM_DIM * (BITS - 1 - level))) & (CHILDREN - 1);
+}
+
+/**
+ * @brief Gravitational acceleration at a position
+ *
+ * @param pos the position
+ * @param gravityConstant G
+ * @param softening added to the distance as sqrt(r^2 + softening^2), keeps close encounters finite
+ * @param openingAngle a cell is taken as its center of mass when its edge length is below openingAngle times the distance
+ * @return glm::vec3 the acceleration
+ *
+ * @details
+ * A cell that contains pos is always opened. Bodies at exactly pos, like the particle
+ * itself, do not pull.
+ */
+glm::vec3 BarnesHutTree::Acceleration(const glm::vec3& pos, float gravityConstant, float softening, float openingAngle) const
+{
+    glm::vec3 acc(0.0f);
+    float softening2 = softening * softening;
+    float theta2 = openingAngle * openingAngle;
+
+    unsigned int n = 0;
+    unsigned int nodeCount = (unsigned int)m_Nodes.size();
+    while (n < nodeCount)
+    {
+        const GravityNode& node = m_Nodes[n];
+        glm::vec3 d = glm::vec3(node.massCenter) - pos;
+        float r2 = glm::dot(d, d);
+        float edge = 2.0f * node.cell.w;
+        bool inside = glm::all(glm::lessThanEqual(glm::abs(pos - glm::vec3(node.cell)), glm::vec3(node.cell.w)));
+
+        if (!inside && edge * edge < theta2 * r2)
+        {
+            acc += node.massCenter.w * d * InverseCube(r2 + softening2);
+            n = node.next;
+        }
+        else if (node.count > 0)
+        {
+            for (unsigned int k = node.first; k < node.first + node.count; k++)
+            {
+                glm::vec3 body = glm::vec3(m_SortedBodies[k]) - pos;
+                float bodyR2 = glm::dot(body, body);
+                if (bodyR2 > 0.0f)
+                    acc += m_SortedBodies[k].w * body * InverseCube(bodyR2 + softening2);
+            }
+            n = node.next;
+        }
+        else
+        {
+            n++;
+        }
+    }
+    return gravityConstant * acc;
+}
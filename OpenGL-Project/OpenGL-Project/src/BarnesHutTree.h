@@ -0,0 +1,100 @@
+/**
+ * @file BarnesHutTree.h
+ * @brief This file contains the BarnesHutTree class and its methods.
+ *
+ * @details This file contains the BarnesHutTree class, the quadtree (2D) or octree (3D)
+ * of the particle masses used for the mutual gravity of ForceMode::BarnesHut.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "MortonOrder.h"
+#include "SimConfig.h"
+#include "ThreadPool.h"
+
+class Particle;
+class ParticleSoA;
+
+/**
+ * @brief Node of a BarnesHutTree, std430 layout of the GravityNode struct in Compute.glsl
+ */
+struct GravityNode
+{
+	glm::vec4 massCenter;	///< xyz center of mass, w total mass
+	glm::vec4 cell;			///< xyz center of the cell, w half its edge length
+	unsigned int next;		///< first node after the subtree of this node
+	unsigned int first;		///< first body of a leaf in the tree order
+	unsigned int count;		///< bodies of a leaf, 0 for an internal node
+	unsigned int padding;
+};
+
+static_assert(sizeof(GravityNode) == 48, "GravityNode must match the GravityNode struct in Compute.glsl");
+
+/**
+ * @class BarnesHutTree
+ * @brief Barnes-Hut tree of the particle masses
+ *
+ * @details
+ * The bodies are sorted by the Morton code of their position in the cubic bounding box,
+ * so the bodies of every cell are a contiguous range. The nodes are stored depth first:
+ * the first child of an internal node is the next node and every node knows the node
+ * after its subtree. Acceleration walks the tree without a stack, the same loop runs
+ * in Compute.glsl on the uploaded nodes and bodies.
+ *
+ * Build is split over a ThreadPool: the Morton codes are computed and sorted with
+ * MortonOrder::ComputeKeys and MortonOrder::SortKeys, bucketed by the cell of level
+ * TOP_LEVELS they fall in, and the buckets are built into subtrees in parallel. The top levels are then built over
+ * the subtrees. The tree is the same as a sequential build.
+ *
+ * A cell with at most LEAF_SIZE bodies, or at the depth of the Morton code, is a leaf.
+ */
+class BarnesHutTree
+{
+public:
+	BarnesHutTree();
+	~BarnesHutTree();
+
+	void Build(const Particle* particles, size_t count, ThreadPool& threadPool);
+	void Build(const ParticleSoA& particles, ThreadPool& threadPool);
+
+	glm::vec3 Acceleration(const glm::vec3& pos, float gravityConstant, float softening, float openingAngle) const;
+
+	const std::vector<GravityNode>& GetNodes() const { return m_Nodes; }
+	const std::vector<glm::vec4>& GetBodies() const { return m_SortedBodies; }	///< position and mass in tree order
+	unsigned int GetParticleIndex(size_t body) const { return (unsigned int)m_Keys[body]; }	///< particle of a body in tree order
+
+	static constexpr unsigned int LEAF_SIZE = 8;
+	static constexpr unsigned int BITS = MortonOrder::BITS;	///< Morton code bits per axis, also the deepest level
+	static constexpr unsigned int TOP_LEVELS = SIM_DIM == 2 ? 3 : 2;	///< levels above the subtrees that are built in parallel
+	static constexpr unsigned int BUCKETS = 1u << (SIM_DIM * TOP_LEVELS);
+
+private:
+	void Build(ThreadPool& threadPool);
+	unsigned int BuildSubtree(std::vector<GravityNode>& nodes, unsigned int begin, unsigned int end, unsigned int level, const glm::vec3& center, float half) const;
+	void BuildTop(unsigned int prefix, unsigned int level, const glm::vec3& center, float half);
+
+	void SetLeaf(GravityNode& node, unsigned int begin, unsigned int end) const;
+	unsigned int Digit(unsigned int body, unsigned int level) const;
+
+	std::vector<glm::vec4> m_Bodies;			///< position and mass per particle
+	std::vector<uint64_t> m_Unsorted;			///< m_Keys before the sort
+	std::vector<uint64_t> m_Keys;				///< Morton code in the high and particle index in the low 32 bits, sorted
+	std::vector<glm::vec4> m_SortedBodies;		///< m_Bodies in the order of m_Keys
+	std::vector<unsigned int> m_BucketStart;	///< first body of every bucket, one extra entry for the end
+	std::vector<std::vector<GravityNode>> m_Subtrees;	///< nodes of every bucket, next relative to the subtree
+	std::vector<GravityNode> m_Nodes;
+
+	glm::vec3 m_Origin;			///< lower corner of the cubic bounding box
+	float m_Extent;				///< edge length of the bounding box
+};
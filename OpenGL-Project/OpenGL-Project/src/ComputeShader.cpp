@@ -17,11 +17,166 @@
 #include "ComputeShader.h"
 
 #include "GLmacros.h"
+#include "ParticleSoA.h"
+#include "ProgramCache.h"
+#include "GpuProfiler.h"
 
 #include <iostream>
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <utility>
+
+/// local_size_x of Compute.glsl until SetWorkgroupSize or AutoTuneWorkgroupSize picks another
+static constexpr unsigned int DEFAULT_WORKGROUP_SIZE = 128;
+/// Sizes timed by AutoTuneWorkgroupSize, the smallest also sizes the block sum buffer
+static constexpr unsigned int WORKGROUP_CANDIDATES[] = { 32, 64, 128, 256, 512 };
+static constexpr unsigned int MIN_WORKGROUP_SIZE = 32;
+/// Steps timed per candidate
+static constexpr unsigned int TUNE_STEPS = 8;
+
+/// Must match the RenderBuffer binding in Compute.glsl and the vertex shaders
+static constexpr unsigned int RENDER_STREAM_BINDING = 6;
+/// Bytes per particle in the render stream
+static constexpr unsigned int RENDER_STREAM_STRIDE = 12;
+/// Must match the AttributeBuffer binding in Compute.glsl
+static constexpr unsigned int ATTRIBUTE_BINDING = 1;
+/// Binding of the active id list, unused by Compute.glsl
+static constexpr unsigned int ACTIVE_ID_BINDING = 7;
+/// Must match the SimParamsBlock binding in Compute.glsl
+static constexpr unsigned int PARAMS_BINDING = 0;
+/// Must match the GravityNodeBuffer, GravityBodyBuffer and GravityOwnerBuffer bindings in Compute.glsl
+static constexpr unsigned int GRAVITY_NODE_BINDING = 8;
+static constexpr unsigned int GRAVITY_BODY_BINDING = 9;
+static constexpr unsigned int GRAVITY_OWNER_BINDING = 14;
+/// Must match the MeshGridBuffer and MeshSpectrumBuffer bindings in Compute.glsl
+static constexpr unsigned int MESH_GRID_BINDING = 8;
+static constexpr unsigned int MESH_SPECTRUM_BINDING = 9;
+/// Must match the ScatterIndexBuffer binding in Compute.glsl
+static constexpr unsigned int SCATTER_INDEX_BINDING = 13;
+/// Must match the CollisionBuffer binding in Compute.glsl
+static constexpr unsigned int COLLISION_BINDING = 10;
+/// Bytes per particle in the collision buffer, a position correction and a velocity
+static constexpr unsigned int COLLISION_STRIDE = 2 * sizeof(glm::vec4);
+/// Must match the PairForceBuffer binding in Compute.glsl
+static constexpr unsigned int PAIR_FORCE_BINDING = 8;
+/// Must match the PermutedDataBuffer and PermutedAttributeBuffer bindings in Compute.glsl
+static constexpr unsigned int PERMUTED_PARTICLE_BINDING = 11;
+static constexpr unsigned int PERMUTED_ATTRIBUTE_BINDING = 12;
+/// Largest particle mesh, s_Fft holds 2 * cells complex floats in the 32 KB of shared memory OpenGL 4.3 guarantees
+static constexpr unsigned int MAX_MESH_CELLS = ParticleMesh::MAX_CELLS;
+static_assert(MAX_MESH_CELLS <= 1024, "s_Fft of the largest particle mesh must fit in 32 KB of shared memory");
+
+/// Passes of one simulation step, must match the PASS_ defines in Compute.glsl
+enum ComputePass
+{
+    PASS_INTEGRATE = 0,
+    PASS_SCAN_BLOCKS,
+    PASS_SCAN_BLOCK_SUMS,
+    PASS_SCAN_ADD,
+    PASS_SCATTER,
+    PASS_SORT_CELLS,
+    PASS_COLLIDE,
+    PASS_APPLY_COLLISIONS,
+    PASS_MESH_CLEAR,
+    PASS_MESH_DEPOSIT,
+    PASS_MESH_ROWS,
+    PASS_MESH_COLUMNS,
+    PASS_MESH_CONVOLVE,
+    PASS_MESH_INVERSE_COLUMNS,
+    PASS_MESH_INVERSE_ROWS,
+    PASS_ALL_PAIRS,
+    PASS_PERMUTE
+};
+
+/// Profiler label of a pass
+static const char* PassLabel(int pass)
+{
+    switch (pass)
+    {
+    case PASS_INTEGRATE: return "Integrate";
+    case PASS_COLLIDE:
+    case PASS_APPLY_COLLISIONS: return "Collide";
+    case PASS_ALL_PAIRS: return "Pairs";
+    case PASS_PERMUTE: return "Reorder";
+    default: return pass >= PASS_MESH_CLEAR ? "Mesh" : "Grid";
+    }
+}
+
+/// Persistent mapped buffers need glBufferStorage, core since OpenGL 4.4
+static bool BufferStorageSupported()
+{
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+/// Upload count elements of elementSize bytes from data, starting at element first
+static void UploadRange(GLuint buffer, size_t elementSize, size_t first, size_t count, const void* data)
+{
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer));
+    GLCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, first * elementSize, count * elementSize, (const unsigned char*)data + first * elementSize));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+}
+
+/// Copy one element of elementSize bytes inside a buffer
+static void CopyElement(GLuint buffer, size_t elementSize, size_t source, size_t destination)
+{
+    GLCall(glBindBuffer(GL_COPY_READ_BUFFER, buffer));
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, buffer));
+    GLCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, source * elementSize, destination * elementSize, elementSize));
+    GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+}
+
+/// Map a buffer and copy its first bytes to destination, waits for the gpu
+static void ReadBuffer(GLuint buffer, size_t bytes, void* destination)
+{
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer));
+    void* mappedData = glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_READ_ONLY);
+    if (mappedData == nullptr)
+    {
+        std::cerr << "Error: Failed to map SSBO buffer." << std::endl;
+        GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+        return;
+    }
+
+    std::memcpy(destination, mappedData, bytes);
+    GLCall(glUnmapBuffer(GL_SHADER_STORAGE_BUFFER));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+}
+
+/// Copy of the first bytes of a buffer into a new buffer
+static GLuint CloneBuffer(GLuint buffer, GLsizeiptr bytes)
+{
+    GLuint clone = 0;
+    GLCall(glGenBuffers(1, &clone));
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, clone));
+    GLCall(glBufferData(GL_COPY_WRITE_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW));
+    GLCall(glBindBuffer(GL_COPY_READ_BUFFER, buffer));
+    GLCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, bytes));
+    GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    return clone;
+}
+
+/// Replace a buffer by a new one of newBytes, the first copyBytes are copied on the gpu
+static GLuint GrowBuffer(GLuint buffer, GLsizeiptr newBytes, GLsizeiptr copyBytes)
+{
+    GLuint grown = 0;
+    GLCall(glGenBuffers(1, &grown));
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, grown));
+    GLCall(glBufferData(GL_COPY_WRITE_BUFFER, newBytes, nullptr, GL_DYNAMIC_DRAW));
+    if (buffer != 0 && copyBytes > 0)
+    {
+        GLCall(glBindBuffer(GL_COPY_READ_BUFFER, buffer));
+        GLCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, copyBytes));
+        GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    }
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+    GLCall(glDeleteBuffers(1, &buffer));
+    return grown;
+}
 
 /**
  * @brief Constructor
@@ -29,9 +184,21 @@
  * @param filepath path to the compute shader 
  */
 ComputeShader::ComputeShader(const std::string& filepath)
-    : m_Filepath(filepath), m_RendererID(0), m_SSBO(0), m_SSBO_ActiveID(0)
+    : m_Filepath(filepath), m_RendererID(0), m_SSBO(0), m_SSBO_Attributes(0), m_SSBO_ActiveID(0), m_Capacity(0), m_ActiveIDCapacity(0),
+    m_SSBO_CellCount(0), m_SSBO_CellStart(0), m_SSBO_SortedIndex(0), m_SSBO_ScatterIndex(0), m_SSBO_BlockSum(0), m_SSBO_Render(0), m_SSBO_Collisions(0),
+    m_SSBO_GravityNodes(0), m_SSBO_GravityBodies(0), m_SSBO_GravityOwners(0), m_SSBO_MeshGrid(0), m_SSBO_MeshSpectrum(0),
+    m_SSBO_PairForces(0), m_PairForceCapacity(0), m_SSBO_Permuted(0), m_SSBO_PermutedAttributes(0), m_PermuteCapacity(0),
+    m_GridMin(0.0f), m_GridDim(0), m_CellSize(0.0f),
+    m_Integrator(Integrator::Euler), m_ResetPast(false), m_WorkgroupSize(DEFAULT_WORKGROUP_SIZE), m_ForceMode(ForceMode::None),
+    m_MeshCells(ParticleMesh::DEFAULT_CELLS), m_ReorderInterval(0), m_StepsSinceReorder(0), m_PermutePending(false), m_Profiler(nullptr), m_Params(), m_UBO_Params(0), m_ParamsMapped(nullptr), m_ParamsFences(), m_ParamsStride(0), m_ParamsFrame(0),
+    m_ReadbackMode(ReadbackMode::Synchronous), m_SSBO_Readback(0), m_ReadbackMapped(nullptr),
+    m_ReadbackRegions(), m_ReadbackFrame(0), m_ReadbackNext(0)
 {  
     m_RendererID = CreateShader(filepath);
+    initParams();
+
+    if (BufferStorageSupported())
+        m_ReadbackMode = ReadbackMode::TripleBuffered;
 }
 
 /**
@@ -39,6 +206,13 @@ ComputeShader::ComputeShader(const std::string& filepath)
  */
 ComputeShader::~ComputeShader()
 {
+    ReleaseReadback();
+    ReleaseParams();
+
+    GLuint buffers[] = { m_SSBO, m_SSBO_Attributes, m_SSBO_ActiveID, m_SSBO_CellCount, m_SSBO_CellStart, m_SSBO_SortedIndex, m_SSBO_ScatterIndex, m_SSBO_BlockSum, m_SSBO_Render, m_SSBO_Collisions,
+        m_SSBO_GravityNodes, m_SSBO_GravityBodies, m_SSBO_GravityOwners, m_SSBO_MeshGrid, m_SSBO_MeshSpectrum, m_SSBO_PairForces,
+        m_SSBO_Permuted, m_SSBO_PermutedAttributes };
+    GLCall(glDeleteBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers));
     GLCall(glDeleteProgram(m_RendererID));
 }
 
@@ -68,6 +242,36 @@ std::string ComputeShader::ReadShaderFile(const std::string& filepath)
     }
 }
 
+/**
+ * @brief Add the compile time configuration to the shader source
+ * 
+ * @param source content of the shader file
+ * @return std::string the source with the defines after the #version line
+ * 
+ * @details
+ * DIM is set to SIM_DIM, so the Particle struct of the shader matches the Particle class.
+ * WORKGROUP_SIZE is set to the workgroup size the passes are dispatched with.
+ * FORCE_MODE is set to the ForceMode, it declares the buffers of that mode.
+ * PM_GRID is set to the cells per axis of the particle mesh.
+ */
+std::string ComputeShader::InjectDefines(const std::string& source)
+{
+    std::stringstream defines;
+    defines << "#define DIM " << SIM_DIM << "\n";
+    defines << "#define WORKGROUP_SIZE " << m_WorkgroupSize << "\n";
+    defines << "#define FORCE_MODE " << (int)m_ForceMode << "\n";
+    defines << "#define PM_GRID " << m_MeshCells << "\n";
+
+    size_t version = source.find("#version");
+    size_t lineEnd = version == std::string::npos ? std::string::npos : source.find('\n', version);
+    if (lineEnd == std::string::npos)
+        return defines.str() + source;
+
+    std::string result = source;
+    result.insert(lineEnd + 1, defines.str());
+    return result;
+}
+
 /**
  * @brief Compiles a shader and returns its ID.
  * 
@@ -122,12 +326,21 @@ unsigned int ComputeShader::CompileShader(unsigned int type, const std::string&
  * and then compiles the shader. If the shader fails to compile, an error message is printed to the
  * console, and the shader ID is not created (returns 0). The method also handles OpenGL-specific
  * compilation errors and cleans up resources if needed.
+ * The program is loaded from the ProgramCache when it holds a binary of the same source and
+ * defines for this driver, so every workgroup size is compiled once.
  */
 unsigned int ComputeShader::CreateShader(const std::string& computeshader)
 {
+    std::string shadercode = InjectDefines(ReadShaderFile(computeshader));
+
+    std::string key = ProgramCache::Key({ shadercode });
+    unsigned int cached = ProgramCache::Load(key);
+    if (cached != 0)
+        return cached;
+
     unsigned int program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
 
-    std::string shadercode = ReadShaderFile(computeshader);
     unsigned int cs = CompileShader(GL_COMPUTE_SHADER, shadercode);
 
     glAttachShader(program, cs);
@@ -137,6 +350,7 @@ unsigned int ComputeShader::CreateShader(const std::string& computeshader)
 
     glDeleteShader(cs);
 
+    ProgramCache::Store(key, program);
     return program;
 }
 
@@ -171,13 +385,359 @@ void ComputeShader::Unbind() const
  * 
  * @details
  * Preallocate memory to the gpu, sizeof(Data) * maxSize
+ * The particle attributes, the two particle index buffers of the grid, the render
+ * stream, the collisions and the readback ring are allocated with the same size.
+ * Calling it again replaces the old buffers.
  */
 void ComputeShader::initSSBO(unsigned int size)
 {
+    m_Capacity = size;
+
+    GLuint buffers[] = { m_SSBO, m_SSBO_Attributes, m_SSBO_SortedIndex, m_SSBO_ScatterIndex, m_SSBO_Render, m_SSBO_Collisions };
+    GLCall(glDeleteBuffers(sizeof(buffers) / sizeof(buffers[0]), buffers));
+
     GLCall(glGenBuffers(1, &m_SSBO));
     GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO));
     GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, size * sizeof(Particle), nullptr, GL_DYNAMIC_DRAW));
+
+    GLCall(glGenBuffers(1, &m_SSBO_Attributes));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_Attributes));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, size * sizeof(ParticleAttributes), nullptr, GL_DYNAMIC_DRAW));
+
+    GLCall(glGenBuffers(1, &m_SSBO_SortedIndex));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_SortedIndex));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, size * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW));
+
+    GLCall(glGenBuffers(1, &m_SSBO_ScatterIndex));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_ScatterIndex));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, size * sizeof(unsigned int), nullptr, GL_DYNAMIC_COPY));
+
+    GLCall(glGenBuffers(1, &m_SSBO_Render));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_Render));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)size * RENDER_STREAM_STRIDE, nullptr, GL_DYNAMIC_COPY));
+
+    GLCall(glGenBuffers(1, &m_SSBO_Collisions));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_Collisions));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)size * COLLISION_STRIDE, nullptr, GL_DYNAMIC_COPY));
     GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+
+    initReadback();
+}
+
+/**
+ * @brief Initialize the readback ring
+ * 
+ * @details
+ * Allocate READBACK_REGIONS regions of m_Capacity particles with glBufferStorage and map
+ * them once, persistent and coherent, so the copies can be read without mapping.
+ * A region holds the particles followed by their attributes.
+ * Falls back to the Synchronous readback mode when the mapping fails.
+ */
+void ComputeShader::initReadback()
+{
+    ReleaseReadback();
+
+    if (m_ReadbackMode == ReadbackMode::Synchronous || m_Capacity == 0)
+        return;
+
+    GLsizeiptr bytes = (GLsizeiptr)READBACK_REGIONS * ReadbackRegionBytes();
+    GLbitfield flags = GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+    GLCall(glGenBuffers(1, &m_SSBO_Readback));
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, m_SSBO_Readback));
+    GLCall(glBufferStorage(GL_COPY_WRITE_BUFFER, bytes, nullptr, flags));
+    m_ReadbackMapped = (unsigned char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, bytes, flags);
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+
+    if (m_ReadbackMapped == nullptr)
+    {
+        std::cerr << "Error: Failed to map readback buffer, falling back to synchronous readback." << std::endl;
+        ReleaseReadback();
+        m_ReadbackMode = ReadbackMode::Synchronous;
+    }
+}
+
+/**
+ * @brief Delete the readback ring and its fences
+ * 
+ * @details
+ * The copy counter keeps counting, so handles to the deleted copies expire.
+ */
+void ComputeShader::ReleaseReadback()
+{
+    for (ReadbackRegion& region : m_ReadbackRegions)
+    {
+        if (region.fence)
+        {
+            GLCall(glDeleteSync(region.fence));
+        }
+        region = ReadbackRegion();
+    }
+
+    GLCall(glDeleteBuffers(1, &m_SSBO_Readback));   ///< also unmaps the buffer
+    m_SSBO_Readback = 0;
+    m_ReadbackMapped = nullptr;
+    m_ReadbackNext = m_ReadbackFrame;
+}
+
+/**
+ * @brief Select the integration scheme of Update
+ * 
+ * @param integrator the integration scheme
+ * 
+ * @details
+ * The past fields written by the previous scheme are ignored for the first step,
+ * the Verlet schemes then start from the current position and velocity.
+ */
+void ComputeShader::SetIntegrator(Integrator integrator)
+{
+    if (integrator == m_Integrator)
+        return;
+
+    m_Integrator = integrator;
+    m_ResetPast = true;
+}
+
+/**
+ * @brief Select the forces between the particles
+ * 
+ * @param mode the force mode
+ * 
+ * @details
+ * Rebuilds the program with the FORCE_MODE of the mode, from the ProgramCache when
+ * it was used before. The buffers are not touched.
+ */
+void ComputeShader::SetForceMode(ForceMode mode)
+{
+    if (mode == m_ForceMode)
+        return;
+
+    m_ForceMode = mode;
+    if (m_ForceMode != ForceMode::None && !m_ForceThreads)
+        m_ForceThreads = std::make_unique<ThreadPool>();
+
+    GLCall(glDeleteProgram(m_RendererID));
+    m_RendererID = CreateShader(m_Filepath);
+    m_UniformLocationCache.clear();
+}
+
+/**
+ * @brief Set the cells per axis of the particle mesh of ForceMode::ParticleMesh
+ * 
+ * @param cells a power of two from 2 to MAX_MESH_CELLS
+ * @return true when the size is used
+ * 
+ * @details
+ * The size is injected as PM_GRID, the program is rebuilt. The Green's function is
+ * computed again before the next step.
+ */
+bool ComputeShader::SetMeshSize(unsigned int cells)
+{
+    if (cells < 2 || cells > MAX_MESH_CELLS || (cells & (cells - 1)) != 0)
+    {
+        std::cerr << "Particle mesh size " << cells << " is not supported!" << std::endl;
+        return false;
+    }
+    if (cells == m_MeshCells)
+        return true;
+
+    m_MeshCells = cells;
+    GLCall(glDeleteProgram(m_RendererID));
+    m_RendererID = CreateShader(m_Filepath);
+    m_UniformLocationCache.clear();
+    return true;
+}
+
+/**
+ * @brief Set how often the particles are sorted along the Morton curve
+ * 
+ * @param steps steps between two reorders, 0 never reorders
+ * 
+ * @details
+ * The first reorder runs in the Update after steps steps.
+ */
+void ComputeShader::SetReorderInterval(unsigned int steps)
+{
+    m_ReorderInterval = steps;
+    if (m_ReorderInterval != 0 && !m_ForceThreads)
+        m_ForceThreads = std::make_unique<ThreadPool>();
+}
+
+/**
+ * @brief Check if the gpu supports a workgroup size
+ * 
+ * @param size number of invocations per workgroup
+ * @return true when size is a power of two within the compute limits of the gpu
+ */
+bool ComputeShader::IsWorkgroupSizeSupported(unsigned int size) const
+{
+    if (size < MIN_WORKGROUP_SIZE || (size & (size - 1)) != 0)
+        return false;
+
+    GLint maxSizeX = 0;
+    GLint maxInvocations = 0;
+    GLCall(glGetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_SIZE, 0, &maxSizeX));
+    GLCall(glGetIntegerv(GL_MAX_COMPUTE_WORK_GROUP_INVOCATIONS, &maxInvocations));
+    return size <= (unsigned int)maxSizeX && size <= (unsigned int)maxInvocations;
+}
+
+/**
+ * @brief Rebuild the program with another workgroup size
+ * 
+ * @param size number of invocations per workgroup, a supported power of two
+ * @return true when the program was rebuilt
+ * 
+ * @details
+ * The size is injected as WORKGROUP_SIZE into Compute.glsl and every pass is
+ * dispatched with it. The buffers are not touched.
+ */
+bool ComputeShader::SetWorkgroupSize(unsigned int size)
+{
+    if (!IsWorkgroupSizeSupported(size))
+    {
+        std::cerr << "Workgroup size " << size << " is not supported!" << std::endl;
+        return false;
+    }
+    if (size == m_WorkgroupSize)
+        return true;
+
+    m_WorkgroupSize = size;
+    GLCall(glDeleteProgram(m_RendererID));
+    m_RendererID = CreateShader(m_Filepath);
+    m_UniformLocationCache.clear();
+    return true;
+}
+
+/**
+ * @brief Pick the fastest workgroup size for this gpu
+ * 
+ * @param sample particles to time the simulation step with
+ * @param cachePath file with the winner per driver
+ * @return unsigned int the selected workgroup size
+ * 
+ * @details
+ * When the cache holds a size for the vendor, renderer and version of the driver that
+ * size is used. Otherwise every supported size of WORKGROUP_CANDIDATES is timed with
+ * GL_TIME_ELAPSED queries over TUNE_STEPS steps of the sample particles, after one
+ * warm up step, and the fastest one is stored in the cache. When the driver reports
+ * the same time for every size the default size is kept and cached, so the next start
+ * does not time again.
+ *
+ * The particle, attribute and render stream buffers are saved before and restored after
+ * timing, so the live particles do not move and the sample is never drawn.
+ * initSSBO and initGrid must have been called.
+ */
+unsigned int ComputeShader::AutoTuneWorkgroupSize(const ParticleSystem& sample, const std::string& cachePath)
+{
+    std::string key = ProgramCache::DriverKey();
+
+    std::ifstream cacheIn(cachePath);
+    std::string line;
+    while (std::getline(cacheIn, line))
+    {
+        size_t separator = line.rfind('=');
+        if (separator == std::string::npos || line.compare(0, separator, key) != 0 || separator != key.size())
+            continue;
+
+        unsigned int cached = (unsigned int)std::strtoul(line.c_str() + separator + 1, nullptr, 10);
+        if (SetWorkgroupSize(cached))
+        {
+            std::cout << "Workgroup size " << m_WorkgroupSize << " from " << cachePath << std::endl;
+            return m_WorkgroupSize;
+        }
+    }
+    cacheIn.close();
+
+    unsigned int count = (unsigned int)std::min(sample.size(), (size_t)m_Capacity);
+    if (count == 0)
+        return m_WorkgroupSize;
+
+    GLuint savedParticles = CloneBuffer(m_SSBO, (GLsizeiptr)m_Capacity * sizeof(Particle));
+    GLuint savedAttributes = CloneBuffer(m_SSBO_Attributes, (GLsizeiptr)m_Capacity * sizeof(ParticleAttributes));
+    GLuint savedRender = CloneBuffer(m_SSBO_Render, (GLsizeiptr)m_Capacity * RENDER_STREAM_STRIDE);
+    bool resetPast = m_ResetPast;
+    GpuProfiler* profiler = m_Profiler;
+    m_Profiler = nullptr;       ///< the timing steps are not stages of the frame
+
+    GLuint query = 0;
+    GLCall(glGenQueries(1, &query));
+
+    unsigned int best = m_WorkgroupSize;
+    GLuint64 bestTime = ~(GLuint64)0;
+    GLuint64 worstTime = 0;
+    for (unsigned int size : WORKGROUP_CANDIDATES)
+    {
+        if (!IsWorkgroupSizeSupported(size) || !SetWorkgroupSize(size))
+            continue;
+
+        UploadRange(m_SSBO, sizeof(Particle), 0, count, sample.data());
+        UploadRange(m_SSBO_Attributes, sizeof(ParticleAttributes), 0, count, sample.attributes());
+        DispatchSteps(count, 0.01f, 1);
+
+        GLuint64 elapsed = 0;
+        GLCall(glBeginQuery(GL_TIME_ELAPSED, query));
+        DispatchSteps(count, 0.01f, TUNE_STEPS);
+        GLCall(glEndQuery(GL_TIME_ELAPSED));
+        GLCall(glGetQueryObjectui64v(query, GL_QUERY_RESULT, &elapsed));
+
+        std::cout << "Workgroup size " << size << ": " << elapsed / 1000.0 / TUNE_STEPS << " us per step" << std::endl;
+        worstTime = std::max(worstTime, elapsed);
+        if (elapsed < bestTime)
+        {
+            bestTime = elapsed;
+            best = size;
+        }
+    }
+
+    GLCall(glDeleteQueries(1, &query));
+
+    bool timed = bestTime > 0 && bestTime < worstTime;     ///< some drivers report the same dummy time for every query
+    if (!timed)
+        best = DEFAULT_WORKGROUP_SIZE;
+    SetWorkgroupSize(best);
+
+    GLCall(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+    GLCall(glDeleteBuffers(1, &m_SSBO));
+    GLCall(glDeleteBuffers(1, &m_SSBO_Attributes));
+    GLCall(glDeleteBuffers(1, &m_SSBO_Render));
+    m_SSBO = savedParticles;
+    m_SSBO_Attributes = savedAttributes;
+    m_SSBO_Render = savedRender;
+    m_ResetPast = resetPast;
+    m_Profiler = profiler;
+
+    if (!timed)
+        std::cout << "Timer queries gave no usable times, keeping workgroup size " << best << std::endl;
+
+    std::ofstream cacheOut(cachePath, std::ios::app);
+    if (cacheOut)
+        cacheOut << key << "=" << best << "\n";
+    else
+        std::cerr << "Could not write the workgroup size cache " << cachePath << std::endl;
+
+    std::cout << "Workgroup size " << best << " selected" << std::endl;
+    return best;
+}
+
+/**
+ * @brief Select how RetrieveData reads the particles back
+ * 
+ * @param mode the readback mode
+ * 
+ * @details
+ * TripleBuffered and OnDemand need OpenGL 4.4 or ARB_buffer_storage, without it
+ * the Synchronous mode is kept. Takes effect immediately when initSSBO was called.
+ */
+void ComputeShader::SetReadbackMode(ReadbackMode mode)
+{
+    if (mode != ReadbackMode::Synchronous && !BufferStorageSupported())
+    {
+        std::cerr << "Error: Asynchronous readback needs glBufferStorage, using synchronous readback." << std::endl;
+        mode = ReadbackMode::Synchronous;
+    }
+
+    m_ReadbackMode = mode;
+    initReadback();
 }
 
 /**
@@ -191,6 +751,9 @@ void ComputeShader::initSSBO(unsigned int size)
  */
 void ComputeShader::initSSBOActiveIDlist(unsigned int size)
 {
+    m_ActiveIDCapacity = size;
+
+    GLCall(glDeleteBuffers(1, &m_SSBO_ActiveID));
     GLCall(glGenBuffers(1, &m_SSBO_ActiveID));
     GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_ActiveID));
     GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, size * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW));
@@ -198,100 +761,934 @@ void ComputeShader::initSSBOActiveIDlist(unsigned int size)
 }
 
 /**
- * @brief upload the list of active id's
+ * @brief Grow the buffers to the capacity of the particlesystem
  * 
- * @param idlist list of active id's
+ * @param particlesystem the particlesystem the buffers belong to
  * 
  * @details
- * Upload the list of active id's to the gpu
+ * Allocate larger particle, attribute, sorted index, render stream and active id buffers and copy the live
+ * range into them with glCopyBufferSubData, so nothing goes through the cpu.
+ * The live range includes the sources of moves that are not applied yet.
+ * The readback ring is allocated again, pending readback handles expire.
  */
-void ComputeShader::UploadIDlist(const std::vector<unsigned int>& idlist)
+void ComputeShader::Reserve(const ParticleSystem& particlesystem)
 {
-    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_ActiveID));
-    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_SSBO_ActiveID));
-    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, idlist.size() * sizeof(unsigned int), idlist.data(), GL_DYNAMIC_DRAW));
-    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+    unsigned int capacity = particlesystem.GetMaxNumber();
+    if (capacity <= m_Capacity)
+        return;
+
+    size_t live = particlesystem.size();
+    for (const std::pair<unsigned int, unsigned int>& move : particlesystem.GetMoves())
+        live = std::max(live, (size_t)move.first + 1);
+    live = std::min(live, (size_t)m_Capacity);
+
+    GLCall(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+    m_SSBO = GrowBuffer(m_SSBO, (GLsizeiptr)capacity * sizeof(Particle), live * sizeof(Particle));
+    m_SSBO_Attributes = GrowBuffer(m_SSBO_Attributes, (GLsizeiptr)capacity * sizeof(ParticleAttributes), live * sizeof(ParticleAttributes));
+    m_SSBO_SortedIndex = GrowBuffer(m_SSBO_SortedIndex, (GLsizeiptr)capacity * sizeof(unsigned int), 0);
+    m_SSBO_ScatterIndex = GrowBuffer(m_SSBO_ScatterIndex, (GLsizeiptr)capacity * sizeof(unsigned int), 0);
+    m_SSBO_Collisions = GrowBuffer(m_SSBO_Collisions, (GLsizeiptr)capacity * COLLISION_STRIDE, 0);
+    m_SSBO_Render = GrowBuffer(m_SSBO_Render, (GLsizeiptr)capacity * RENDER_STREAM_STRIDE, std::min(particlesystem.size(), (size_t)m_Capacity) * RENDER_STREAM_STRIDE);
+    m_Capacity = capacity;
+
+    if (m_SSBO_ActiveID != 0 && capacity > m_ActiveIDCapacity)
+    {
+        size_t ids = std::min(particlesystem.size(), (size_t)m_ActiveIDCapacity);
+        m_SSBO_ActiveID = GrowBuffer(m_SSBO_ActiveID, (GLsizeiptr)capacity * sizeof(unsigned int), ids * sizeof(unsigned int));
+        m_ActiveIDCapacity = capacity;
+    }
+
+    initReadback();
 }
 
 /**
- * @brief Upload data to the ssbo
+ * @brief Initialize the uniform grid used for the particle collisions
  * 
- * @param particlesystem the data to upload
+ * @param boundsMin lower corner of the simulation area
+ * @param boundsMax upper corner of the simulation area
+ * @param cellSize edge length of a cell, at least the largest particle diameter
  * 
  * @details
- * Upload the data to the gpu
+ * Allocate the per cell buffers on the gpu. Particles outside the bounds are
+ * assigned to the nearest border cell. The cell counts start at zero and are
+ * back at zero after every step, so they are only cleared here.
  */
-void ComputeShader::UploadData(ParticleSystem& particlesystem)
+void ComputeShader::initGrid(const glm::vec2& boundsMin, const glm::vec2& boundsMax, float cellSize)
 {
-    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO));
-    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_SSBO));
-    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, particlesystem.size() * sizeof(Particle), particlesystem.data(), GL_DYNAMIC_DRAW));
+    m_GridMin = boundsMin;
+    m_CellSize = cellSize;
+    m_GridDim = glm::max(glm::ivec2(glm::ceil((boundsMax - boundsMin) / cellSize)), glm::ivec2(1));
+
+    unsigned int cellTotal = m_GridDim.x * m_GridDim.y;
+    unsigned int blockCount = (cellTotal + MIN_WORKGROUP_SIZE - 1) / MIN_WORKGROUP_SIZE;   ///< enough for every workgroup size
+    const unsigned int zero = 0;
+
+    GLCall(glGenBuffers(1, &m_SSBO_CellCount));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_CellCount));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, cellTotal * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW));
+    GLCall(glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero));
+
+    GLCall(glGenBuffers(1, &m_SSBO_CellStart));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_CellStart));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, cellTotal * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW));
+
+    GLCall(glGenBuffers(1, &m_SSBO_BlockSum));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_BlockSum));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, blockCount * sizeof(unsigned int), nullptr, GL_DYNAMIC_DRAW));
     GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
 }
 
 /**
- * @brief Upload data to the ssbo
+ * @brief upload the list of active id's
  * 
- * @param particlesystem the data to upload
- * @param position position to upload the data
- * @param newParticle the data to upload
+ * @param idlist list of active id's
  * 
  * @details
- * Upload the data to the gpu
- * This method is used to add a new particle to the ssbo
- * at a specific position
+ * Upload the list of active id's into the buffer preallocated by initSSBOActiveIDlist
  */
-void ComputeShader::UploadAddElement(ParticleSystem& particlesystem, Particle& newParticle, unsigned int position)
+void ComputeShader::UploadIDlist(const std::vector<unsigned int>& idlist)
 {
-    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO));
-    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_SSBO));
-    glBufferSubData(GL_SHADER_STORAGE_BUFFER, position * sizeof(Particle), sizeof(Particle), &newParticle);
+    if (idlist.size() > m_ActiveIDCapacity)
+    {
+        std::cerr << "Error: " << idlist.size() << " id's do not fit in the SSBO of " << m_ActiveIDCapacity << std::endl;
+        return;
+    }
+
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_ActiveID));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ACTIVE_ID_BINDING, m_SSBO_ActiveID));
+    GLCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, idlist.size() * sizeof(unsigned int), idlist.data()));
     GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
 }
 
 /**
- * @brief Update the compute shader
+ * @brief Upload data to the ssbo
  * 
- * @param particlesystem the data to update
- * @param deltaTime time between frames
+ * @param particlesystem the data to upload
  * 
  * @details
- * Update the compute shader
- * Dispatch the compute shader
- * Memory barrier
+ * Upload all particles into the buffer preallocated by initSSBO.
+ * Clears the dirty ranges and moves of the particlesystem, everything is up to date.
  */
-void ComputeShader::Update(ParticleSystem& particlesystem, float deltaTime)
+void ComputeShader::UploadData(ParticleSystem& particlesystem)
 {
-    GLCall(glUseProgram(m_RendererID));
-    GLCall(glUniform1f(glGetUniformLocation(m_RendererID, "deltaTime"), deltaTime));
-    GLCall(glDispatchCompute((particlesystem.size() + 63) / 64, 1, 1));
-    GLCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+    ProfileScope scope(m_Profiler, "Upload");
+    Reserve(particlesystem);
+    if (particlesystem.size() > m_Capacity)
+    {
+        std::cerr << "Error: " << particlesystem.size() << " particles do not fit in the SSBO of " << m_Capacity << std::endl;
+        return;
+    }
+
+    UploadRange(m_SSBO, sizeof(Particle), 0, particlesystem.size(), particlesystem.data());
+    UploadRange(m_SSBO_Attributes, sizeof(ParticleAttributes), 0, particlesystem.size(), particlesystem.attributes());
+
+    particlesystem.ClearDirtyRanges();
+    particlesystem.ClearMoves();
 }
 
 /**
- * @brief Retrieve data from the ssbo
+ * @brief Upload the changed particles to the ssbo
  * 
- * @param particlesystem the data to retrieve
+ * @param particlesystem the data to upload
  * 
  * @details
- * Retrieve the data from the gpu
- * Copy the data to the particlesystem
+ * Merge the dirty ranges recorded by creating and destroying particles and
+ * upload only those ranges into the buffer preallocated by initSSBO.
+ * The particles that are not dirty keep their state on the gpu.
+ *
+ * The moves recorded by destroying gpu resident particles are applied first,
+ * in order, as copies inside the ssbo. The buffers grow first when the
+ * capacity of the particlesystem grew.
  */
-void ComputeShader::RetrieveData(ParticleSystem& particlesystem)
+void ComputeShader::UploadDirty(ParticleSystem& particlesystem)
 {
-    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO));
-    Particle* mappedData = (Particle*)glMapBuffer(GL_SHADER_STORAGE_BUFFER, GL_READ_ONLY);
-    if (mappedData == nullptr)
+    ProfileScope scope(m_Profiler, "Upload");
+    Reserve(particlesystem);
+
+    if (!particlesystem.GetMoves().empty())
     {
-        std::cerr << "Error: Failed to map SSBO buffer." << std::endl;
-        GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
-        return;
+        GLCall(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+        for (const std::pair<unsigned int, unsigned int>& move : particlesystem.GetMoves())
+        {
+            CopyElement(m_SSBO, sizeof(Particle), move.first, move.second);
+            CopyElement(m_SSBO_Attributes, sizeof(ParticleAttributes), move.first, move.second);
+        }
+        particlesystem.ClearMoves();
     }
 
-    std::memcpy(particlesystem.data(), mappedData, particlesystem.size() * sizeof(Particle));
-    GLCall(glUnmapBuffer(GL_SHADER_STORAGE_BUFFER));
-    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
-}
+    particlesystem.MergeDirtyRanges();
+    if (particlesystem.GetDirtyRanges().empty())
+        return;
+
+    for (const std::pair<unsigned int, unsigned int>& range : particlesystem.GetDirtyRanges())
+    {
+        if (range.second > m_Capacity)
+        {
+            std::cerr << "Error: particle " << range.second - 1 << " does not fit in the SSBO of " << m_Capacity << std::endl;
+            break;
+        }
+
+        UploadRange(m_SSBO, sizeof(Particle), range.first, range.second - range.first, particlesystem.data());
+        UploadRange(m_SSBO_Attributes, sizeof(ParticleAttributes), range.first, range.second - range.first, particlesystem.attributes());
+    }
+
+    particlesystem.ClearDirtyRanges();
+}
+
+/**
+ * @brief Upload structure of arrays data to the ssbo
+ * 
+ * @param particles the data to upload
+ * 
+ * @details
+ * Scatter the arrays into the Particle and ParticleAttributes layout of the ssbo's and upload them
+ */
+void ComputeShader::UploadData(const ParticleSoA& particles)
+{
+    ProfileScope scope(m_Profiler, "Upload");
+    if (particles.size() > m_Capacity)
+    {
+        std::cerr << "Error: " << particles.size() << " particles do not fit in the SSBO of " << m_Capacity << std::endl;
+        return;
+    }
+
+    particles.Scatter(m_Staging, m_StagingAttributes);
+
+    UploadRange(m_SSBO, sizeof(Particle), 0, m_Staging.size(), m_Staging.data());
+    UploadRange(m_SSBO_Attributes, sizeof(ParticleAttributes), 0, m_StagingAttributes.size(), m_StagingAttributes.data());
+}
+
+/**
+ * @brief Upload data to the ssbo
+ * 
+ * @param particlesystem the data to upload
+ * @param position position to upload the data
+ * @param newParticle the data to upload
+ * 
+ * @details
+ * Upload the data to the gpu
+ * This method is used to add a new particle to the ssbo
+ * at a specific position, its attributes are taken from the particlesystem
+ */
+void ComputeShader::UploadAddElement(ParticleSystem& particlesystem, Particle& newParticle, unsigned int position)
+{
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO));
+    GLCall(glBufferSubData(GL_SHADER_STORAGE_BUFFER, position * sizeof(Particle), sizeof(Particle), &newParticle));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+    UploadRange(m_SSBO_Attributes, sizeof(ParticleAttributes), position, 1, particlesystem.attributes());
+}
+
+/**
+ * @brief Update the compute shader
+ * 
+ * @param particlesystem the data to update
+ * @param deltaTime time of one step
+ * @param steps number of steps
+ * 
+ * @details
+ * Update the compute shader
+ * Dispatch the passes of one simulation step in order:
+ * integrate and count per cell, prefix sum the cell counts,
+ * sort the particles by cell and every cell by index, collide with the
+ * neighbouring cells, apply the collisions and write the render stream.
+ * initGrid must have been called before the first update.
+ *
+ * Several steps are dispatched back to back with only memory barriers in between,
+ * the buffers and parameters are bound once. Only the last step writes the render
+ * stream and only after the last step the particles are copied for readback.
+ *
+ * When SetReorderInterval steps have passed the particles are sorted along the Morton
+ * curve before the steps, see PrepareReorder.
+ *
+ * Afterwards the gpu holds newer particles than the cpu in every readback mode, so the
+ * particlesystem is marked gpu resident and destroying records moves on the gpu.
+ */
+void ComputeShader::Update(ParticleSystem& particlesystem, float deltaTime, unsigned int steps)
+{
+    unsigned int count = (unsigned int)particlesystem.size();
+    if (count == 0 || steps == 0)
+        return;
+
+    if (m_ReorderInterval != 0 && m_StepsSinceReorder >= m_ReorderInterval)
+        PrepareReorder(particlesystem);
+
+    DispatchSteps(count, deltaTime, steps);
+    m_StepsSinceReorder += steps;
+    particlesystem.SetGpuResident(true);
+
+    if (m_ReadbackMode == ReadbackMode::TripleBuffered && m_ReadbackMapped != nullptr)
+    {
+        ProfileScope scope(m_Profiler, "Readback");
+        CopyToReadback(particlesystem);
+    }
+}
+
+/**
+ * @brief Dispatch the passes of several simulation steps
+ * 
+ * @param count number of particles in the buffers
+ * @param deltaTime time of one step
+ * @param steps number of steps
+ */
+void ComputeShader::DispatchSteps(unsigned int count, float deltaTime, unsigned int steps)
+{
+    unsigned int cellTotal = m_GridDim.x * m_GridDim.y;
+
+    GLCall(glUseProgram(m_RendererID));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_SSBO));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ATTRIBUTE_BINDING, m_SSBO_Attributes));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, m_SSBO_CellCount));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 3, m_SSBO_CellStart));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 4, m_SSBO_SortedIndex));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, SCATTER_INDEX_BINDING, m_SSBO_ScatterIndex));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COLLISION_BINDING, m_SSBO_Collisions));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 5, m_SSBO_BlockSum));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RENDER_STREAM_BINDING, m_SSBO_Render));
+
+    if (m_ForceMode == ForceMode::ParticleMesh)
+        PrepareMesh();
+    else if (m_ForceMode == ForceMode::AllPairs)
+        PreparePairForces();
+    WriteParams(count, deltaTime);
+
+    if (m_PermutePending)
+        DispatchPermute(count);
+
+    // one tree for all steps, the steps after the first see the bodies of the first
+    if (m_ForceMode == ForceMode::BarnesHut)
+        UploadGravityTree(count);
+
+    for (unsigned int step = 0; step < steps; step++)
+    {
+        SetUniform1i("resetPast", m_ResetPast);
+        SetUniform1i("writeRenderStream", step + 1 == steps);
+        m_ResetPast = false;
+
+        if (m_ForceMode == ForceMode::ParticleMesh)
+            DispatchMesh(count);
+        else if (m_ForceMode == ForceMode::AllPairs)
+            Dispatch(PASS_ALL_PAIRS, count);
+
+        Dispatch(PASS_INTEGRATE, count);
+        Dispatch(PASS_SCAN_BLOCKS, cellTotal);
+        Dispatch(PASS_SCAN_BLOCK_SUMS, m_WorkgroupSize);
+        Dispatch(PASS_SCAN_ADD, cellTotal);
+        Dispatch(PASS_SCATTER, count);
+        Dispatch(PASS_SORT_CELLS, count);
+        Dispatch(PASS_COLLIDE, count);
+        Dispatch(PASS_APPLY_COLLISIONS, count);
+    }
+
+    GLsync& fence = m_ParamsFences[(m_ParamsFrame - 1) % PARAMS_REGIONS];
+    fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+/**
+ * @brief Build the Barnes-Hut tree of the particles on the cpu from a readback and upload it
+ * 
+ * @param count number of particles in the buffers
+ * 
+ * @details
+ * Reads the particles back, which waits for the passes issued before, builds the
+ * tree on m_ForceThreads and uploads the nodes and the bodies in tree order.
+ * The integrate pass reads the positions of the other particles from the bodies,
+ * so it does not race with the particles it moves. The particle index of every body
+ * is uploaded too, so a particle that moved away from its body skips it.
+ *
+ * DispatchSteps calls this once per batch of steps, so the readback stalls the
+ * pipeline once per Update instead of once per step.
+ */
+void ComputeShader::UploadGravityTree(unsigned int count)
+{
+    ProfileScope scope(m_Profiler, "Tree");
+
+    m_Staging.resize(count, Particle(glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f));
+    GLCall(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+    ReadBuffer(m_SSBO, count * sizeof(Particle), m_Staging.data());
+
+    m_GravityTree.Build(m_Staging.data(), count, *m_ForceThreads);
+    const std::vector<GravityNode>& nodes = m_GravityTree.GetNodes();
+    const std::vector<glm::vec4>& bodies = m_GravityTree.GetBodies();
+    m_GravityOwners.resize(bodies.size());
+    for (size_t k = 0; k < bodies.size(); k++)
+        m_GravityOwners[k] = m_GravityTree.GetParticleIndex(k);
+
+    if (m_SSBO_GravityNodes == 0)
+    {
+        GLCall(glGenBuffers(1, &m_SSBO_GravityNodes));
+        GLCall(glGenBuffers(1, &m_SSBO_GravityBodies));
+        GLCall(glGenBuffers(1, &m_SSBO_GravityOwners));
+    }
+
+    // a new store every Update, the driver orphans the one the last Update still reads
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_GravityNodes));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, nodes.size() * sizeof(GravityNode), nodes.data(), GL_STREAM_DRAW));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_GravityBodies));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, bodies.size() * sizeof(glm::vec4), bodies.data(), GL_STREAM_DRAW));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_GravityOwners));
+    GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, m_GravityOwners.size() * sizeof(unsigned int), m_GravityOwners.data(), GL_STREAM_DRAW));
+    GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GRAVITY_NODE_BINDING, m_SSBO_GravityNodes));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GRAVITY_BODY_BINDING, m_SSBO_GravityBodies));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, GRAVITY_OWNER_BINDING, m_SSBO_GravityOwners));
+}
+
+/**
+ * @brief Set up the grid of the particle mesh for the next steps
+ * 
+ * @details
+ * The grid covers the walls. When the walls, the size or the softening changed the
+ * spectrum of the Green's function is computed on m_ForceThreads and uploaded behind
+ * the spectrum of the grid, the buffers are allocated with it.
+ */
+void ComputeShader::PrepareMesh()
+{
+    bool changed = m_ParticleMesh.Configure(glm::vec3(m_Params.screenMin), glm::vec3(m_Params.screenMax), m_MeshCells, m_Params.softening, *m_ForceThreads);
+    m_Params.pmCellSize = m_ParticleMesh.GetCellSize();
+
+    if (changed || m_SSBO_MeshGrid == 0)
+    {
+        ProfileScope scope(m_Profiler, "Mesh");
+
+        if (m_SSBO_MeshGrid == 0)
+        {
+            GLCall(glGenBuffers(1, &m_SSBO_MeshGrid));
+            GLCall(glGenBuffers(1, &m_SSBO_MeshSpectrum));
+        }
+
+        const std::vector<float>& green = m_ParticleMesh.GetGreenSpectrum();
+        size_t cells = (size_t)m_MeshCells * m_MeshCells * (SIM_DIM == 3 ? m_MeshCells : 1);
+        std::vector<glm::vec2> spectrum(2 * green.size(), glm::vec2(0.0f));
+        for (size_t i = 0; i < green.size(); i++)
+            spectrum[green.size() + i] = glm::vec2(green[i], 0.0f);
+
+        GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_MeshGrid));
+        GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, cells * sizeof(float), nullptr, GL_DYNAMIC_COPY));
+        GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_MeshSpectrum));
+        GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, spectrum.size() * sizeof(glm::vec2), spectrum.data(), GL_DYNAMIC_COPY));
+        GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+    }
+
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_GRID_BINDING, m_SSBO_MeshGrid));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, MESH_SPECTRUM_BINDING, m_SSBO_MeshSpectrum));
+}
+
+/**
+ * @brief Dispatch the particle mesh passes that solve the potential for the integrate pass
+ * 
+ * @param count number of particles in the buffers
+ * 
+ * @details
+ * The transform passes run one workgroup per row or column of the grid.
+ * Only the rows and columns that hold mass or potential are transformed, the padding
+ * is zero and is never written.
+ */
+void ComputeShader::DispatchMesh(unsigned int count)
+{
+    unsigned int cells = m_MeshCells;
+    unsigned int rows = SIM_DIM == 3 ? cells * cells : cells;
+    unsigned int columns = (cells + 1) * (SIM_DIM == 3 ? cells : 1);	// along y of the planes with mass
+    unsigned int convolved = (cells + 1) * (SIM_DIM == 3 ? 2 * cells : 1);	// along the last axis
+
+    Dispatch(PASS_MESH_CLEAR, rows * cells);
+    Dispatch(PASS_MESH_DEPOSIT, count);
+    Dispatch(PASS_MESH_ROWS, rows * m_WorkgroupSize);
+    if (SIM_DIM == 3)
+        Dispatch(PASS_MESH_COLUMNS, columns * m_WorkgroupSize);
+    Dispatch(PASS_MESH_CONVOLVE, convolved * m_WorkgroupSize);
+    if (SIM_DIM == 3)
+        Dispatch(PASS_MESH_INVERSE_COLUMNS, columns * m_WorkgroupSize);
+    Dispatch(PASS_MESH_INVERSE_ROWS, rows * m_WorkgroupSize);
+}
+
+/**
+ * @brief Allocate and bind the gravity per particle of ForceMode::AllPairs
+ * 
+ * @details
+ * The buffer follows the capacity of the particle buffers, it is only read and
+ * written on the gpu.
+ */
+void ComputeShader::PreparePairForces()
+{
+    if (m_SSBO_PairForces == 0)
+    {
+        GLCall(glGenBuffers(1, &m_SSBO_PairForces));
+    }
+
+    if (m_PairForceCapacity < m_Capacity)
+    {
+        m_PairForceCapacity = m_Capacity;
+        GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_PairForces));
+        GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)m_PairForceCapacity * sizeof(glm::vec4), nullptr, GL_DYNAMIC_COPY));
+        GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+    }
+
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PAIR_FORCE_BINDING, m_SSBO_PairForces));
+}
+
+/**
+ * @brief Sort the particles along the Morton curve on the cpu for the next permute pass
+ * 
+ * @param particlesystem the particles of the buffers, permuted the same way
+ * 
+ * @details
+ * Pending moves and dirty ranges refer to the old order, they are uploaded first. The
+ * positions are read back, which waits for the previous update, and sorted by the
+ * Morton code in the walls with m_ForceThreads. The order is uploaded into
+ * m_SSBO_SortedIndex, which the step overwrites after the permute pass has read it.
+ * The ParticleSystem gets the same permutation and a new layout version, so older
+ * copies in the readback ring are skipped.
+ */
+void ComputeShader::PrepareReorder(ParticleSystem& particlesystem)
+{
+    ProfileScope scope(m_Profiler, "Reorder");
+
+    UploadDirty(particlesystem);
+    unsigned int count = (unsigned int)particlesystem.size();
+
+    m_Staging.resize(count, Particle(glm::vec3(0.0f), glm::vec3(0.0f), 0.0f, 0.0f));
+    GLCall(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+    ReadBuffer(m_SSBO, count * sizeof(Particle), m_Staging.data());
+
+    m_MortonOrder.Sort(m_Staging.data(), count, glm::vec3(m_Params.screenMin), glm::vec3(m_Params.screenMax), *m_ForceThreads);
+    const std::vector<unsigned int>& order = m_MortonOrder.GetOrder();
+    UploadRange(m_SSBO_SortedIndex, sizeof(unsigned int), 0, count, order.data());
+
+    if (m_PermuteCapacity < m_Capacity)
+    {
+        GLuint buffers[] = { m_SSBO_Permuted, m_SSBO_PermutedAttributes };
+        GLCall(glDeleteBuffers(2, buffers));
+
+        GLCall(glGenBuffers(1, &m_SSBO_Permuted));
+        GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_Permuted));
+        GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)m_Capacity * sizeof(Particle), nullptr, GL_DYNAMIC_DRAW));
+        GLCall(glGenBuffers(1, &m_SSBO_PermutedAttributes));
+        GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, m_SSBO_PermutedAttributes));
+        GLCall(glBufferData(GL_SHADER_STORAGE_BUFFER, (GLsizeiptr)m_Capacity * sizeof(ParticleAttributes), nullptr, GL_DYNAMIC_DRAW));
+        GLCall(glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0));
+        m_PermuteCapacity = m_Capacity;
+    }
+
+    particlesystem.ApplyPermutation(order);
+    particlesystem.ClearDirtyRanges();     ///< the gpu is permuted by the permute pass, nothing to upload
+    m_PermutePending = true;
+    m_StepsSinceReorder = 0;
+}
+
+/**
+ * @brief Gather the particles into the order of PrepareReorder
+ * 
+ * @param count number of particles in the buffers
+ * 
+ * @details
+ * The permute pass writes into the spare buffers, which are swapped with the particle
+ * buffers and bound in their place. Both have m_PermuteCapacity particles.
+ */
+void ComputeShader::DispatchPermute(unsigned int count)
+{
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PERMUTED_PARTICLE_BINDING, m_SSBO_Permuted));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, PERMUTED_ATTRIBUTE_BINDING, m_SSBO_PermutedAttributes));
+    Dispatch(PASS_PERMUTE, count);
+
+    std::swap(m_SSBO, m_SSBO_Permuted);
+    std::swap(m_SSBO_Attributes, m_SSBO_PermutedAttributes);
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, m_SSBO));
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, ATTRIBUTE_BINDING, m_SSBO_Attributes));
+    m_PermutePending = false;
+}
+
+/**
+ * @brief Initialize the parameter ring
+ * 
+ * @details
+ * Allocate PARAMS_REGIONS regions of SimParams, each aligned to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+ * so it can be bound with glBindBufferRange. With glBufferStorage the ring is mapped once,
+ * persistent and coherent, otherwise the regions are written with glBufferSubData.
+ */
+void ComputeShader::initParams()
+{
+    ReleaseParams();
+
+    GLint alignment = 0;
+    GLCall(glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment));
+    if (alignment < 1) { alignment = 1; }
+    m_ParamsStride = ((GLsizeiptr)sizeof(SimParams) + alignment - 1) / alignment * alignment;
+
+    GLsizeiptr bytes = (GLsizeiptr)PARAMS_REGIONS * m_ParamsStride;
+
+    GLCall(glGenBuffers(1, &m_UBO_Params));
+    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_UBO_Params));
+    if (BufferStorageSupported())
+    {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLCall(glBufferStorage(GL_UNIFORM_BUFFER, bytes, nullptr, flags));
+        m_ParamsMapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, bytes, flags);
+    }
+    else
+    {
+        GLCall(glBufferData(GL_UNIFORM_BUFFER, bytes, nullptr, GL_DYNAMIC_DRAW));
+    }
+    GLCall(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+}
+
+/**
+ * @brief Delete the parameter ring and its fences
+ */
+void ComputeShader::ReleaseParams()
+{
+    for (GLsync& fence : m_ParamsFences)
+    {
+        if (fence)
+        {
+            GLCall(glDeleteSync(fence));
+        }
+        fence = 0;
+    }
+
+    GLCall(glDeleteBuffers(1, &m_UBO_Params));   ///< also unmaps the buffer
+    m_UBO_Params = 0;
+    m_ParamsMapped = nullptr;
+}
+
+/**
+ * @brief Write the parameters of an update into the next region of the ring and bind it
+ * 
+ * @param count number of particles in the buffers
+ * @param deltaTime time of one step
+ * 
+ * @details
+ * The region was last read by the update PARAMS_REGIONS updates ago, its fence is
+ * normally signalled long before, so this only waits when the gpu is that far behind.
+ */
+void ComputeShader::WriteParams(unsigned int count, float deltaTime)
+{
+    unsigned int region = m_ParamsFrame++ % PARAMS_REGIONS;
+    GLsync& fence = m_ParamsFences[region];
+    if (fence)
+    {
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+            std::cerr << "Error: Waiting for the simulation parameters failed." << std::endl;
+        GLCall(glDeleteSync(fence));
+        fence = 0;
+    }
+
+    m_Params.gridMin = m_GridMin;
+    m_Params.gridDim = m_GridDim;
+    m_Params.cellSize = m_CellSize;
+    m_Params.deltaTime = deltaTime;
+    m_Params.particleCount = count;
+    m_Params.integrator = (int)m_Integrator;
+
+    GLintptr offset = (GLintptr)region * m_ParamsStride;
+    if (m_ParamsMapped != nullptr)
+    {
+        std::memcpy(m_ParamsMapped + offset, &m_Params, sizeof(SimParams));
+    }
+    else
+    {
+        GLCall(glBindBuffer(GL_UNIFORM_BUFFER, m_UBO_Params));
+        GLCall(glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(SimParams), &m_Params));
+        GLCall(glBindBuffer(GL_UNIFORM_BUFFER, 0));
+    }
+
+    GLCall(glBindBufferRange(GL_UNIFORM_BUFFER, PARAMS_BINDING, m_UBO_Params, offset, sizeof(SimParams)));
+}
+
+/**
+ * @brief Set the walls the particles bounce off
+ * 
+ * @param boundsMin lower corner, z is ignored in a 2D simulation
+ * @param boundsMax upper corner
+ */
+void ComputeShader::SetBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    m_Params.screenMin = glm::vec4(boundsMin, 0.0f);
+    m_Params.screenMax = glm::vec4(boundsMax, 0.0f);
+}
+
+/**
+ * @brief Set the velocity kept after a collision
+ * 
+ * @param wall factor after bouncing off a wall
+ * @param particle factor after a particle collision
+ */
+void ComputeShader::SetFriction(float wall, float particle)
+{
+    m_Params.frictionW = wall;
+    m_Params.frictionP = particle;
+}
+
+/**
+ * @brief Set the acceleration added to every particle
+ * 
+ * @param gravity acceleration, z is ignored in a 2D simulation
+ */
+void ComputeShader::SetGravity(const glm::vec3& gravity)
+{
+    m_Params.gravity = glm::vec4(gravity, 0.0f);
+}
+
+/**
+ * @brief Set the mutual gravity of the force modes
+ * 
+ * @param gravityConstant G
+ * @param softening added to the distance as sqrt(r^2 + softening^2), at least half a cell of the particle mesh
+ * @param openingAngle cells smaller than openingAngle times their distance are not opened, 0 is exact, BarnesHut only
+ */
+void ComputeShader::SetGravitation(float gravityConstant, float softening, float openingAngle)
+{
+    m_Params.gravityConstant = gravityConstant;
+    m_Params.softening = softening;
+    m_Params.openingAngle = openingAngle;
+}
+
+/**
+ * @brief Copy the particles into the next region of the readback ring
+ * 
+ * @param particlesystem the particles that were updated
+ * @return unsigned int copy number
+ * 
+ * @details
+ * The copy runs on the gpu after the update, a fence marks when it is done.
+ * The region that is overwritten is the oldest one, RetrieveData has either
+ * read it or skipped it for a newer one.
+ */
+unsigned int ComputeShader::CopyToReadback(const ParticleSystem& particlesystem)
+{
+    unsigned int count = (unsigned int)particlesystem.size();
+    unsigned int region = m_ReadbackFrame % READBACK_REGIONS;
+    ReadbackRegion& target = m_ReadbackRegions[region];
+
+    if (target.fence)
+    {
+        GLCall(glDeleteSync(target.fence));
+    }
+
+    GLintptr offset = (GLintptr)region * ReadbackRegionBytes();
+
+    GLCall(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, m_SSBO_Readback));
+    GLCall(glBindBuffer(GL_COPY_READ_BUFFER, m_SSBO));
+    GLCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, offset, count * sizeof(Particle)));
+    GLCall(glBindBuffer(GL_COPY_READ_BUFFER, m_SSBO_Attributes));
+    GLCall(glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0,
+        offset + (GLintptr)m_Capacity * sizeof(Particle), count * sizeof(ParticleAttributes)));
+    GLCall(glBindBuffer(GL_COPY_READ_BUFFER, 0));
+    GLCall(glBindBuffer(GL_COPY_WRITE_BUFFER, 0));
+
+    target.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    target.count = count;
+    target.layoutVersion = particlesystem.GetLayoutVersion();
+    target.frame = m_ReadbackFrame;
+    return m_ReadbackFrame++;
+}
+
+/**
+ * @brief Request a snapshot of the particles
+ * 
+ * @param particlesystem the particles on the gpu
+ * @return ReadbackHandle handle to poll
+ * 
+ * @details
+ * Copies the particles into the readback ring behind the commands issued so far,
+ * this does not wait for the gpu. Poll the handle with PollReadback and read it with
+ * ReadReadback once it is Ready. At most READBACK_REGIONS requests can be in flight,
+ * a newer request reuses the region of the oldest one.
+ */
+ReadbackHandle ComputeShader::RequestReadback(const ParticleSystem& particlesystem)
+{
+    ReadbackHandle handle;
+    if (m_ReadbackMapped == nullptr)
+    {
+        std::cerr << "Error: RequestReadback needs the TripleBuffered or OnDemand readback mode." << std::endl;
+        return handle;
+    }
+
+    handle.frame = CopyToReadback(particlesystem);
+    return handle;
+}
+
+/**
+ * @brief Check if a requested snapshot is ready
+ * 
+ * @param handle handle returned by RequestReadback
+ * @return ReadbackStatus state of the snapshot
+ */
+ReadbackStatus ComputeShader::PollReadback(const ReadbackHandle& handle)
+{
+    if (handle.frame == ReadbackHandle::INVALID_FRAME || m_ReadbackMapped == nullptr)
+        return ReadbackStatus::Expired;
+
+    const ReadbackRegion& region = m_ReadbackRegions[handle.frame % READBACK_REGIONS];
+    if (region.fence == nullptr || region.frame != handle.frame)
+        return ReadbackStatus::Expired;
+
+    GLenum status = glClientWaitSync(region.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+    if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+        return ReadbackStatus::Ready;
+    if (status == GL_WAIT_FAILED)
+        return ReadbackStatus::Expired;
+    return ReadbackStatus::Pending;
+}
+
+/**
+ * @brief Copy a requested snapshot into the particlesystem
+ * 
+ * @param handle handle returned by RequestReadback
+ * @param particlesystem the particlesystem to copy into
+ * @return true when the particles were copied
+ * 
+ * @details
+ * Returns false when the snapshot is not Ready, or when particles were destroyed
+ * after the request so the snapshot no longer matches the dense array.
+ */
+bool ComputeShader::ReadReadback(const ReadbackHandle& handle, ParticleSystem& particlesystem)
+{
+    ProfileScope scope(m_Profiler, "Readback");
+    if (PollReadback(handle) != ReadbackStatus::Ready)
+        return false;
+
+    return CopyFromReadback(handle.frame % READBACK_REGIONS, particlesystem);
+}
+
+/**
+ * @brief Size of one region of the readback ring
+ * 
+ * @return size_t m_Capacity particles followed by m_Capacity attributes, in bytes
+ */
+size_t ComputeShader::ReadbackRegionBytes() const
+{
+    return (size_t)m_Capacity * (sizeof(Particle) + sizeof(ParticleAttributes));
+}
+
+/**
+ * @brief Copy a finished region of the readback ring into the particlesystem
+ * 
+ * @param region index of the region
+ * @param particlesystem the particlesystem to copy into
+ * @return true when the particles were copied
+ * 
+ * @details
+ * The fence of the region must be signalled. Nothing is copied when particles
+ * were destroyed after the copy into the region.
+ */
+bool ComputeShader::CopyFromReadback(unsigned int region, ParticleSystem& particlesystem) const
+{
+    const ReadbackRegion& source = m_ReadbackRegions[region];
+    if (source.layoutVersion != particlesystem.GetLayoutVersion())
+        return false;
+
+    size_t count = source.count < particlesystem.size() ? source.count : particlesystem.size();
+    const unsigned char* particles = m_ReadbackMapped + region * ReadbackRegionBytes();
+    const unsigned char* attributes = particles + (size_t)m_Capacity * sizeof(Particle);
+    std::memcpy(particlesystem.data(), particles, count * sizeof(Particle));
+    std::memcpy(particlesystem.attributes(), attributes, count * sizeof(ParticleAttributes));
+    return true;
+}
+
+/**
+ * @brief Dispatch one pass of the compute shader
+ * 
+ * @param pass the pass to run
+ * @param invocations minimum number of invocations
+ * 
+ * @details
+ * Dispatch enough workgroups to cover the invocations and
+ * make the writes visible to the next pass.
+ */
+void ComputeShader::Dispatch(int pass, unsigned int invocations)
+{
+    ProfileScope scope(m_Profiler, PassLabel(pass));
+    SetUniform1i("pass", pass);
+    GLCall(glDispatchCompute((invocations + m_WorkgroupSize - 1) / m_WorkgroupSize, 1, 1));
+    GLCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+}
+
+/**
+ * @brief Retrieve data from the ssbo
+ * 
+ * @param particlesystem the data to retrieve
+ * 
+ * @details
+ * Retrieve the data from the gpu
+ * Copy the data to the particlesystem
+ *
+ * In the Synchronous and OnDemand mode the ssbo is mapped, which waits for the gpu.
+ * In the TripleBuffered mode the newest copy in the readback ring that the gpu
+ * has finished is read, only when the copy of two updates ago is not done yet
+ * this waits for it. The particles on the cpu can be up to two updates behind
+ * the gpu. Particles created after the copy are kept, a copy made before a
+ * particle was destroyed no longer matches the dense array and is skipped.
+ *
+ * The mapped read first uploads the pending moves and dirty ranges, then the cpu has
+ * the current particles and the particlesystem is unmarked as gpu resident. The copies of the ring may be outdated and keep it.
+ */
+void ComputeShader::RetrieveData(ParticleSystem& particlesystem)
+{
+    ProfileScope scope(m_Profiler, "Readback");
+    if (m_ReadbackMode != ReadbackMode::TripleBuffered || m_ReadbackMapped == nullptr)
+    {
+        if (!particlesystem.GetMoves().empty() || !particlesystem.GetDirtyRanges().empty())
+            UploadDirty(particlesystem);    ///< the gpu must have the dense layout of the cpu
+
+        GLCall(glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT));     ///< the passes only issue the shader storage barrier
+        ReadBuffer(m_SSBO, particlesystem.size() * sizeof(Particle), particlesystem.data());
+        ReadBuffer(m_SSBO_Attributes, particlesystem.size() * sizeof(ParticleAttributes), particlesystem.attributes());
+        particlesystem.SetGpuResident(false);
+        return;
+    }
+
+    if (m_ReadbackNext >= m_ReadbackFrame)
+        return;     ///< no new copy since the last read
+
+    unsigned int newest = m_ReadbackFrame - 1;
+    unsigned int oldest = m_ReadbackFrame > READBACK_REGIONS ? m_ReadbackFrame - READBACK_REGIONS : 0;
+    if (oldest < m_ReadbackNext)
+        oldest = m_ReadbackNext;
+
+    unsigned int frame = newest + 1;
+    for (unsigned int f = newest + 1; f-- > oldest; )
+    {
+        GLenum status = glClientWaitSync(m_ReadbackRegions[f % READBACK_REGIONS].fence, 0, 0);
+        if (status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED)
+        {
+            frame = f;
+            break;
+        }
+    }
+
+    if (frame > newest)
+    {
+        if (newest - oldest < READBACK_REGIONS - 1)
+            return;     ///< the gpu is less than two updates behind, try again next frame
+
+        frame = oldest;
+        GLenum status = glClientWaitSync(m_ReadbackRegions[frame % READBACK_REGIONS].fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+        if (status == GL_WAIT_FAILED || status == GL_TIMEOUT_EXPIRED)
+        {
+            std::cerr << "Error: Waiting for the readback fence failed." << std::endl;
+            return;
+        }
+    }
+
+    m_ReadbackNext = frame + 1;
+    CopyFromReadback(frame % READBACK_REGIONS, particlesystem);
+}
+
+/**
+ * @brief Bind the render stream for the vertex shaders
+ * 
+ * @details
+ * The stream holds the particles of the last Update. The particles created
+ * after it are in the stream after the next Update.
+ */
+void ComputeShader::BindRenderStream() const
+{
+    GLCall(glBindBufferBase(GL_SHADER_STORAGE_BUFFER, RENDER_STREAM_BINDING, m_SSBO_Render));
+    GLCall(glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT));
+}
 
 /**
  * @brief Set uniform int
@@ -307,6 +1704,50 @@ void ComputeShader::SetUniform1i(const std::string& name, int value)
     GLCall(glUniform1i(GetUniformLocation(name), value));
 }
 
+/**
+ * @brief Set uniform unsigned int
+ * 
+ * @param name name of the uniform
+ * @param value value of the uniform
+ * 
+ * @details
+ * Set the uniform unsigned int
+ */
+void ComputeShader::SetUniform1ui(const std::string& name, unsigned int value)
+{
+    GLCall(glUniform1ui(GetUniformLocation(name), value));
+}
+
+/**
+ * @brief Set uniform int2
+ * 
+ * @param name name of the uniform
+ * @param v0 value of the uniform
+ * @param v1 value of the uniform
+ * 
+ * @details
+ * Set the uniform int2
+ */
+void ComputeShader::SetUniform2i(const std::string& name, int v0, int v1)
+{
+    GLCall(glUniform2i(GetUniformLocation(name), v0, v1));
+}
+
+/**
+ * @brief Set uniform float2
+ * 
+ * @param name name of the uniform
+ * @param v0 value of the uniform
+ * @param v1 value of the uniform
+ * 
+ * @details
+ * Set the uniform float2
+ */
+void ComputeShader::SetUniform2f(const std::string& name, float v0, float v1)
+{
+    GLCall(glUniform2f(GetUniformLocation(name), v0, v1));
+}
+
 /**
  * @brief Set uniform float
  * 
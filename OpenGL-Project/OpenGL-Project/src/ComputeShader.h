@@ -19,11 +19,50 @@
 #include <string>
 #include <unordered_map>
 #include <stack>
+#include <memory>
 
 #include <GL/glew.h>
 #include "glm/glm.hpp" 
 
 #include "Particlesystem.h"
+#include "SimConfig.h"
+#include "BarnesHutTree.h"
+#include "ParticleMesh.h"
+#include "MortonOrder.h"
+#include "ThreadPool.h"
+
+class ParticleSoA;
+class GpuProfiler;
+
+/**
+ * @brief How RetrieveData reads the particles back from the gpu
+ */
+enum class ReadbackMode
+{
+	Synchronous,		///< map the ssbo, waits until the gpu finished the last update
+	TripleBuffered,		///< read a persistent mapped copy that the gpu finished earlier
+	OnDemand			///< no copy per update, snapshots are requested with RequestReadback
+};
+
+/**
+ * @brief State of a snapshot requested with ComputeShader::RequestReadback
+ */
+enum class ReadbackStatus
+{
+	Pending,			///< the gpu has not finished the copy yet
+	Ready,				///< the snapshot can be read
+	Expired				///< the region was reused for a newer copy, or the request failed
+};
+
+/**
+ * @brief Handle to a snapshot requested with ComputeShader::RequestReadback
+ */
+struct ReadbackHandle
+{
+	static const unsigned int INVALID_FRAME = 0xFFFFFFFF;
+
+	unsigned int frame = INVALID_FRAME;		///< copy number in the readback ring
+};
 
 /** 
  * @class ComputeShader
@@ -35,6 +74,68 @@
  * The ComputeShader class is used to create, bind, and unbind compute shaders.
  * The class also includes methods for uploading data to the GPU, setting uniforms,
  * and retrieving data from the GPU.
+ *
+ * The particles are stored in two parallel buffers: Particle with the position, velocity,
+ * radius and mass that every pass reads and writes, and ParticleAttributes with the
+ * rest. Uploads, moves, growth and readback always handle both.
+ *
+ * Particle collisions use a uniform grid broad phase: every step the particles are
+ * counted per cell, counting sorted by cell and only tested against the particles
+ * in the neighbouring cells.
+ *
+ * The collisions are resolved in two passes: the collide pass only reads the particles
+ * and writes the position correction and velocity of every particle into a separate
+ * buffer, the apply pass adds them (Jacobi). The scatter order within a cell depends
+ * on the scheduling, so every particle then counts the particles with a lower index in
+ * its cell and takes that place, the neighbours are visited in index order. A step
+ * gives the same bits at every workgroup size and every run.
+ *
+ * In the TripleBuffered readback mode every update ends with a copy of the particles
+ * into one of three regions of a persistent mapped buffer, guarded by a fence.
+ * RetrieveData reads the newest region the gpu has finished, at most two updates
+ * old, so the cpu does not wait for the update that is still running.
+ *
+ * In the OnDemand readback mode nothing is copied per update. RequestReadback copies
+ * the particles into the ring and returns a handle that is polled with PollReadback
+ * and read with ReadReadback, so frames without a request transfer nothing.
+ *
+ * The last pass also writes a render stream of 12 bytes per particle: half float
+ * xy position, half float radius and RGBA8 color. The vertex shaders read that
+ * stream instead of the 24 or 32 byte Particle and the 80 byte ParticleAttributes,
+ * bind it with BindRenderStream.
+ *
+ * The buffers follow the capacity of the ParticleSystem: Reserve allocates larger
+ * buffers and copies the live particles on the gpu, the uploads call it when needed.
+ *
+ * The parameters of the step (bounds, friction, gravity, grid, time step) are one
+ * SimParams struct. Every Update writes it once into the next region of a persistent
+ * mapped uniform buffer ring, so no uniform is looked up or set per parameter.
+ *
+ * In ForceMode::BarnesHut the particles pull each other with their mass. Before the
+ * steps of an Update the positions are read back, a BarnesHutTree is built on the cpu
+ * with a ThreadPool and its nodes and bodies are uploaded, the integrate pass walks
+ * the tree. The readback waits for the previous Update, so this mode synchronises with
+ * the gpu once per Update and waits for the O(n log n) tree build on the cpu. The steps
+ * of one Update share the tree, so with several steps the gravity lags behind the
+ * positions.
+ *
+ * In ForceMode::ParticleMesh the mutual gravity is solved on the gpu: the masses are
+ * deposited on the grid of a ParticleMesh, transformed with Ffts in shared memory,
+ * multiplied by the spectrum of the Green's function and transformed back into the
+ * potential the integrate pass interpolates. Only the spectrum of the Green's function
+ * is computed on the cpu, when the grid or the softening changes, so this mode does
+ * not synchronise with the gpu.
+ *
+ * In ForceMode::AllPairs a pass before the integrate pass sums the exact gravity of
+ * all particles on every particle, a workgroup size tile of particles at a time
+ * through shared memory.
+ *
+ * Every SetReorderInterval steps the particles are sorted along the Morton curve for
+ * memory locality: Update reads the positions back, sorts them with a MortonOrder on
+ * the cpu and applies the permutation to the ParticleSystem, so the ids keep their
+ * particle. The permute pass gathers both particle buffers into spare buffers in the
+ * new order, which then take the place of the particle buffers. Like the gravity tree
+ * the readback synchronises with the gpu, but only once per reorder.
  */
 class ComputeShader
 {
@@ -45,8 +146,82 @@ private:
 
 	std::unordered_map<std::string, int> m_UniformLocationCache;
 
-	GLuint m_SSBO;
+	GLuint m_SSBO;					///< Particle per particle, the data of the simulation step
+	GLuint m_SSBO_Attributes;		///< ParticleAttributes per particle, parallel to m_SSBO
 	GLuint m_SSBO_ActiveID;
+	unsigned int m_Capacity;		///< number of particles allocated in m_SSBO
+	unsigned int m_ActiveIDCapacity;	///< number of ids allocated in m_SSBO_ActiveID
+
+	GLuint m_SSBO_CellCount;		///< particles per grid cell
+	GLuint m_SSBO_CellStart;		///< prefix sum of the cell counts
+	GLuint m_SSBO_SortedIndex;		///< particle indices sorted by grid cell and by index within a cell
+	GLuint m_SSBO_ScatterIndex;		///< particle indices sorted by grid cell in the order of the scatter atomics
+	GLuint m_SSBO_BlockSum;			///< per workgroup totals of the prefix sum
+	GLuint m_SSBO_Render;			///< packed position, radius and color per particle for the vertex shaders
+	GLuint m_SSBO_Collisions;		///< position correction and velocity per particle of the collide pass
+	GLuint m_SSBO_GravityNodes;		///< nodes of m_GravityTree
+	GLuint m_SSBO_GravityBodies;	///< position and mass of the particles in the order of m_GravityTree
+	GLuint m_SSBO_GravityOwners;	///< particle index of every body in m_SSBO_GravityBodies
+	GLuint m_SSBO_MeshGrid;			///< mass, then potential per cell of m_ParticleMesh
+	GLuint m_SSBO_MeshSpectrum;		///< spectrum of the padded grid and of the Green's function of m_ParticleMesh
+	GLuint m_SSBO_PairForces;		///< gravity per particle of ForceMode::AllPairs
+	unsigned int m_PairForceCapacity;	///< number of particles allocated in m_SSBO_PairForces
+	GLuint m_SSBO_Permuted;			///< spare Particle buffer the permute pass gathers into, swapped with m_SSBO
+	GLuint m_SSBO_PermutedAttributes;	///< spare ParticleAttributes buffer, swapped with m_SSBO_Attributes
+	unsigned int m_PermuteCapacity;	///< number of particles allocated in the spare buffers
+
+	std::vector<Particle> m_Staging;	///< Particle layout copy of a ParticleSoA for upload, or of m_SSBO for the gravity tree
+	std::vector<ParticleAttributes> m_StagingAttributes;
+	std::vector<unsigned int> m_GravityOwners;	///< particle index of every body of m_GravityTree, for upload
+
+	glm::vec2 m_GridMin;
+	glm::ivec2 m_GridDim;
+	float m_CellSize;
+
+	Integrator m_Integrator;
+	bool m_ResetPast;				///< the past fields belong to another integrator, ignore them for one step
+
+	unsigned int m_WorkgroupSize;	///< injected as WORKGROUP_SIZE, the size every pass is dispatched with
+
+	ForceMode m_ForceMode;			///< injected as FORCE_MODE
+	BarnesHutTree m_GravityTree;
+	ParticleMesh m_ParticleMesh;	///< grid and Green's function of the ParticleMesh passes
+	unsigned int m_MeshCells;		///< injected as PM_GRID
+	std::unique_ptr<ThreadPool> m_ForceThreads;	///< builds m_GravityTree, the Green's function and m_MortonOrder, created when needed
+
+	MortonOrder m_MortonOrder;
+	unsigned int m_ReorderInterval;	///< steps between two reorders, 0 never reorders
+	unsigned int m_StepsSinceReorder;
+	bool m_PermutePending;			///< the order of the next permute pass is in m_SSBO_SortedIndex
+
+	GpuProfiler* m_Profiler;		///< times the uploads, passes and readbacks, nullptr when not profiled
+
+	static constexpr unsigned int PARAMS_REGIONS = 3;
+
+	SimParams m_Params;				///< parameters of the next Update
+	GLuint m_UBO_Params;			///< PARAMS_REGIONS regions of m_ParamsStride bytes
+	unsigned char* m_ParamsMapped;	///< persistent mapping of m_UBO_Params, nullptr when written with glBufferSubData
+	GLsync m_ParamsFences[PARAMS_REGIONS];	///< signalled when the updates reading the region are done
+	GLsizeiptr m_ParamsStride;		///< sizeof(SimParams) rounded up to the uniform buffer offset alignment
+	unsigned int m_ParamsFrame;		///< number of parameter writes into the ring
+
+	/// One region of the readback ring
+	struct ReadbackRegion
+	{
+		GLsync fence;				///< signalled when the copy into the region is done
+		unsigned int count;			///< number of particles copied
+		unsigned int layoutVersion;	///< ParticleSystem layout version at the time of the copy
+		unsigned int frame;			///< copy number, to recognise handles of older copies
+	};
+
+	static constexpr unsigned int READBACK_REGIONS = 3;
+
+	ReadbackMode m_ReadbackMode;
+	GLuint m_SSBO_Readback;			///< READBACK_REGIONS regions of m_Capacity particles and attributes
+	unsigned char* m_ReadbackMapped;	///< persistent mapping of m_SSBO_Readback
+	ReadbackRegion m_ReadbackRegions[READBACK_REGIONS];
+	unsigned int m_ReadbackFrame;	///< number of copies made into the ring
+	unsigned int m_ReadbackNext;	///< oldest copy that has not been read yet
 
 public:
 	ComputeShader(const std::string& filepath);
@@ -57,21 +232,82 @@ public:
 
 	void initSSBO(unsigned int size);
 	void initSSBOActiveIDlist(unsigned int size);
+	void initGrid(const glm::vec2& boundsMin, const glm::vec2& boundsMax, float cellSize);
+	void Reserve(const ParticleSystem& particlesystem);
+	unsigned int GetCapacity() const { return m_Capacity; }
 	void UploadIDlist(const std::vector<unsigned int>& idlist);
 	void UploadData(ParticleSystem& particlesystem);
+	void UploadData(const ParticleSoA& particles);
+	void UploadDirty(ParticleSystem& particlesystem);
 	void UploadAddElement(ParticleSystem& particlesystem, Particle& newParticle, unsigned int position);
-	void Update(ParticleSystem& particlesystem, float deltaTime);
+	void Update(ParticleSystem& particlesystem, float deltaTime, unsigned int steps = 1);
 	void RetrieveData(ParticleSystem& particlesystem);
+	void BindRenderStream() const;
+
+	void SetIntegrator(Integrator integrator);
+	Integrator GetIntegrator() const { return m_Integrator; }
+
+	void SetBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	void SetFriction(float wall, float particle);
+	void SetGravity(const glm::vec3& gravity);
+	void SetGravitation(float gravityConstant, float softening, float openingAngle);
+	const SimParams& GetParams() const { return m_Params; }
+
+	void SetForceMode(ForceMode mode);
+	ForceMode GetForceMode() const { return m_ForceMode; }
+
+	bool SetMeshSize(unsigned int cells);
+	unsigned int GetMeshSize() const { return m_MeshCells; }
+
+	void SetReorderInterval(unsigned int steps);
+	unsigned int GetReorderInterval() const { return m_ReorderInterval; }
+
+	void SetProfiler(GpuProfiler* profiler) { m_Profiler = profiler; }
+
+	bool SetWorkgroupSize(unsigned int size);
+	unsigned int GetWorkgroupSize() const { return m_WorkgroupSize; }
+	bool IsWorkgroupSizeSupported(unsigned int size) const;
+	unsigned int AutoTuneWorkgroupSize(const ParticleSystem& sample, const std::string& cachePath);
+
+	void SetReadbackMode(ReadbackMode mode);
+	ReadbackMode GetReadbackMode() const { return m_ReadbackMode; }
+
+	ReadbackHandle RequestReadback(const ParticleSystem& particlesystem);
+	ReadbackStatus PollReadback(const ReadbackHandle& handle);
+	bool ReadReadback(const ReadbackHandle& handle, ParticleSystem& particlesystem);
 
 	// Set uniforms
 	void SetUniform1i(const std::string& name, int value);
+	void SetUniform1ui(const std::string& name, unsigned int value);
+	void SetUniform2i(const std::string& name, int v0, int v1);
+	void SetUniform2f(const std::string& name, float v0, float v1);
 	void SetUniform1f(const std::string& name, float value);
 	void SetUniform4f(const std::string& name, float v0, float v1, float f2, float f3);
 	void SetUniformMat4f(const std::string& name, const glm::mat4& matrix);
 private:
 	std::string ReadShaderFile(const std::string& filepath);
+	std::string InjectDefines(const std::string& source);
 	unsigned int CompileShader(unsigned int type, const std::string& source);
 	unsigned int CreateShader(const std::string& computeshader);
+
+	void Dispatch(int pass, unsigned int invocations);
+	void DispatchSteps(unsigned int count, float deltaTime, unsigned int steps);
+	void UploadGravityTree(unsigned int count);
+	void PrepareMesh();
+	void DispatchMesh(unsigned int count);
+	void PreparePairForces();
+	void PrepareReorder(ParticleSystem& particlesystem);
+	void DispatchPermute(unsigned int count);
+
+	void initParams();
+	void ReleaseParams();
+	void WriteParams(unsigned int count, float deltaTime);
+
+	void initReadback();
+	void ReleaseReadback();
+	unsigned int CopyToReadback(const ParticleSystem& particlesystem);
+	bool CopyFromReadback(unsigned int region, ParticleSystem& particlesystem) const;
+	size_t ReadbackRegionBytes() const;
 	
 	int GetUniformLocation(const std::string& name);
 };
\ No newline at end of file
@@ -0,0 +1,595 @@
+/**
+ * @file CpuSimulator.cpp
+ * @brief This file contains the implementation for the CpuSimulator class.
+ *
+ * @details This file contains the c++ port of the simulation step of Compute.glsl.
+ * Every function mirrors the function with the same name in the shader.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "CpuSimulator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "SimdKernels.h"
+
+/**
+ * @brief Constructor
+ *
+ * @param threadCount number of threads, 0 uses every hardware thread
+ */
+CpuSimulator::CpuSimulator(unsigned int threadCount)
+    : m_ThreadPool(threadCount), m_GridMin(0.0f), m_GridDim(1), m_CellSize(1.0f), m_CellStart(2, 0)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+CpuSimulator::~CpuSimulator()
+{
+}
+
+/**
+ * @brief Initialize the uniform grid used for the particle collisions
+ *
+ * @param boundsMin lower corner of the simulation area
+ * @param boundsMax upper corner of the simulation area
+ * @param cellSize edge length of a cell, at least the largest particle diameter
+ *
+ * @details
+ * Same grid as ComputeShader::initGrid. Particles outside the bounds are
+ * assigned to the nearest border cell.
+ */
+void CpuSimulator::initGrid(const glm::vec2& boundsMin, const glm::vec2& boundsMax, float cellSize)
+{
+    m_GridMin = boundsMin;
+    m_CellSize = cellSize;
+    m_GridDim = glm::max(glm::ivec2(glm::ceil((boundsMax - boundsMin) / cellSize)), glm::ivec2(1));
+
+    m_CellStart.assign(m_GridDim.x * m_GridDim.y + 1, 0);
+}
+
+/**
+ * @brief Run one simulation step
+ *
+ * @param particlesystem the data to update
+ * @param deltaTime time step
+ *
+ * @details
+ * Same steps as ComputeShader::Update: compute the forces of the ForceMode,
+ * integrate and collide with the walls,
+ * sort the particles by grid cell and collide with the neighbouring cells.
+ * The results are written directly to the particles of the particlesystem.
+ * When SetReorderInterval steps have passed the particles are first sorted along the
+ * Morton curve, which moves them to other dense indices.
+ */
+void CpuSimulator::Update(ParticleSystem& particlesystem, float deltaTime)
+{
+    size_t count = particlesystem.size();
+    if (count == 0)
+        return;
+
+    if (m_ReorderInterval != 0 && m_StepsSinceReorder >= m_ReorderInterval)
+    {
+        m_MortonOrder.Sort(particlesystem.data(), count, ToVec3(m_ScreenMin), ToVec3(m_ScreenMax), m_ThreadPool);
+        particlesystem.ApplyPermutation(m_MortonOrder.GetOrder());
+        m_StepsSinceReorder = 0;
+    }
+    m_StepsSinceReorder++;
+
+    Particle* particles = particlesystem.data();
+    ParticleAttributes* attributes = particlesystem.attributes();
+    m_CellOf.resize(count);
+
+    if (m_ForceMode == ForceMode::BarnesHut)
+        m_GravityTree.Build(particles, count, m_ThreadPool);
+    else if (m_ForceMode == ForceMode::ParticleMesh)
+    {
+        m_ParticleMesh.Configure(ToVec3(m_ScreenMin), ToVec3(m_ScreenMax), m_MeshCells, m_Softening, m_ThreadPool);
+        m_ParticleMesh.Solve(particles, count, m_ThreadPool);
+    }
+    else if (m_ForceMode == ForceMode::AllPairs)
+    {
+        m_Bodies.resize(count);
+        m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+                m_Bodies[i] = glm::vec4(ToVec3(particles[i].m_Position), particles[i].m_Mass);
+        });
+    }
+    ComputeForces(count);
+
+    m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            Integrate(particles[i], attributes[i], m_Forces[i], deltaTime);
+            CheckCollisionWall(particles[i]);
+            m_CellOf[i] = CellIndex(particles[i].m_Position);
+        }
+    });
+
+    SortByCell(count);
+
+    m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        for (size_t k = begin; k < end; k++)
+        {
+            const Particle& particle = particles[m_SortedIndex[k]];
+            m_SortedPosRadius[k] = glm::vec4(ToVec3(particle.m_Position), particle.m_Radius);
+        }
+    });
+
+    m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            CheckCollisionParticlesGrid(particles[i].m_Position, particles[i].m_Velocity, particles[i].m_Radius, (unsigned int)i);
+            SavePastPosition(particles[i], attributes[i], deltaTime);
+        }
+    });
+
+    m_ResetPast = false;
+}
+
+/**
+ * @brief Run one simulation step on structure of arrays storage
+ *
+ * @param particles the data to update
+ * @param deltaTime time step
+ *
+ * @details
+ * Same step as the ParticleSystem version and the same bits. The integration and the
+ * wall collisions run per axis, each thread on its own chunk. The acceleration of a
+ * particle, the gravity and the forces of the ForceMode are summed first, like in
+ * Integrate, Euler then runs as the SIMD kernel of SimdKernels.h, see IntegrateAxisSoA.
+ */
+void CpuSimulator::Update(ParticleSoA& particles, float deltaTime)
+{
+    size_t count = particles.size();
+    if (count == 0)
+        return;
+
+    m_CellOf.resize(count);
+    m_TotalAcceleration.resize(count);
+
+    if (m_ForceMode == ForceMode::BarnesHut)
+        m_GravityTree.Build(particles, m_ThreadPool);
+    else if (m_ForceMode == ForceMode::ParticleMesh)
+    {
+        m_ParticleMesh.Configure(ToVec3(m_ScreenMin), ToVec3(m_ScreenMax), m_MeshCells, m_Softening, m_ThreadPool);
+        m_ParticleMesh.Solve(particles, m_ThreadPool);
+    }
+    else if (m_ForceMode == ForceMode::AllPairs)
+    {
+        m_Bodies.resize(count);
+        m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+                m_Bodies[i] = glm::vec4(ToVec3(particles.GetPosition(i)), particles.Mass()[i]);
+        });
+    }
+    ComputeForces(count);
+
+    m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        if (deltaTime > 0.0f)
+        {
+            for (int axis = 0; axis < SIM_DIM; axis++)
+            {
+                float* total = m_TotalAcceleration.data();
+                const float* acc = particles.Acceleration(axis);
+                for (size_t i = begin; i < end; i++)
+                    total[i] = acc[i] + m_Gravity[axis] + m_Forces[i][axis];
+                IntegrateAxisSoA(particles, axis, total, begin, end, deltaTime);
+            }
+            if (m_Integrator == Integrator::VelocityVerlet)
+                std::fill(particles.HasPast() + begin, particles.HasPast() + end, 1u);
+        }
+
+        for (int axis = 0; axis < SIM_DIM; axis++)
+            CollideWallSoA(particles.Position(axis) + begin, particles.Velocity(axis) + begin, particles.Radius() + begin, end - begin, m_ScreenMin[axis], m_ScreenMax[axis], m_FrictionW);
+
+        for (size_t i = begin; i < end; i++)
+            m_CellOf[i] = CellIndex(particles.GetPosition(i));
+    });
+
+    SortByCell(count);
+
+    m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        for (size_t k = begin; k < end; k++)
+        {
+            unsigned int i = m_SortedIndex[k];
+            m_SortedPosRadius[k] = glm::vec4(ToVec3(particles.GetPosition(i)), particles.Radius()[i]);
+        }
+    });
+
+    m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            SimVec pos = particles.GetPosition(i);
+            SimVec vel = particles.GetVelocity(i);
+
+            CheckCollisionParticlesGrid(pos, vel, particles.Radius()[i], (unsigned int)i);
+
+            for (int axis = 0; axis < SIM_DIM; axis++)
+            {
+                particles.Position(axis)[i] = pos[axis];
+                particles.Velocity(axis)[i] = vel[axis];
+            }
+
+            if (m_Integrator == Integrator::PositionVerlet && deltaTime > 0.0f)
+            {
+                for (int axis = 0; axis < SIM_DIM; axis++)
+                    particles.PastPosition(axis)[i] = pos[axis] - vel[axis] * deltaTime;
+                particles.HasPast()[i] = 1;
+            }
+        }
+    });
+
+    m_ResetPast = false;
+}
+
+/**
+ * @brief Select the integration scheme of Update
+ *
+ * @param integrator the integration scheme
+ *
+ * @details
+ * Same as ComputeShader::SetIntegrator, the past fields of the previous scheme
+ * are ignored for the first step.
+ */
+void CpuSimulator::SetIntegrator(Integrator integrator)
+{
+    if (integrator == m_Integrator)
+        return;
+
+    m_Integrator = integrator;
+    m_ResetPast = true;
+}
+
+/**
+ * @brief Set the walls the particles bounce off
+ *
+ * @param boundsMin lower corner, z is ignored in a 2D simulation
+ * @param boundsMax upper corner
+ */
+void CpuSimulator::SetBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    m_ScreenMin = ToSimVec(boundsMin);
+    m_ScreenMax = ToSimVec(boundsMax);
+}
+
+/**
+ * @brief Set the velocity kept after a collision
+ *
+ * @param wall factor after bouncing off a wall
+ * @param particle factor after a particle collision
+ */
+void CpuSimulator::SetFriction(float wall, float particle)
+{
+    m_FrictionW = wall;
+    m_FrictionP = particle;
+}
+
+/**
+ * @brief Set the mutual gravity of the force modes
+ *
+ * @param gravityConstant G
+ * @param softening added to the distance as sqrt(r^2 + softening^2), at least half a cell of the particle mesh
+ * @param openingAngle cells smaller than openingAngle times their distance are not opened, 0 is exact, BarnesHut only
+ */
+void CpuSimulator::SetGravitation(float gravityConstant, float softening, float openingAngle)
+{
+    m_GravityConstant = gravityConstant;
+    m_Softening = softening;
+    m_OpeningAngle = openingAngle;
+}
+
+/**
+ * @brief Set the cells per axis of the particle mesh of ForceMode::ParticleMesh
+ *
+ * @param cells a power of two from 2 to ParticleMesh::MAX_CELLS
+ * @return true when the size is used
+ */
+bool CpuSimulator::SetMeshSize(unsigned int cells)
+{
+    if (cells < 2 || cells > ParticleMesh::MAX_CELLS || (cells & (cells - 1)) != 0)
+        return false;
+
+    m_MeshCells = cells;
+    return true;
+}
+
+/**
+ * @brief Compute the acceleration of the ForceMode of every particle into m_Forces
+ *
+ * @param count number of particles
+ *
+ * @details
+ * In ForceMode::BarnesHut m_GravityTree must be built from the particles first,
+ * in ForceMode::ParticleMesh m_ParticleMesh must be solved and in ForceMode::AllPairs
+ * m_Bodies must hold the particles.
+ * All particles are read before any of them moves, like the tree in the shader.
+ */
+void CpuSimulator::ComputeForces(size_t count)
+{
+    m_Forces.resize(count);
+    if (m_ForceMode == ForceMode::None)
+    {
+        std::fill(m_Forces.begin(), m_Forces.end(), glm::vec3(0.0f));
+        return;
+    }
+
+    if (m_ForceMode == ForceMode::ParticleMesh)
+    {
+        const std::vector<glm::vec4>& bodies = m_ParticleMesh.GetBodies();
+        m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+                m_Forces[i] = m_ParticleMesh.Acceleration(glm::vec3(bodies[i]), m_GravityConstant);
+        });
+        return;
+    }
+
+    if (m_ForceMode == ForceMode::AllPairs)
+    {
+        float softening2 = m_Softening * m_Softening;
+        m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                glm::vec3 pos(m_Bodies[i]);
+                glm::vec3 acc(0.0f);
+                for (size_t j = 0; j < count; j++)
+                {
+                    glm::vec3 d = glm::vec3(m_Bodies[j]) - pos;
+                    float r2 = glm::dot(d, d);
+                    if (r2 > 0.0f)
+                    {
+                        float inverse = 1.0f / std::sqrt(r2 + softening2);
+                        acc += m_Bodies[j].w * d * (inverse * inverse * inverse);
+                    }
+                }
+                m_Forces[i] = m_GravityConstant * acc;
+            }
+        });
+        return;
+    }
+
+    // in tree order, so neighbouring threads walk the same nodes
+    const std::vector<glm::vec4>& bodies = m_GravityTree.GetBodies();
+    m_ThreadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        for (size_t k = begin; k < end; k++)
+            m_Forces[m_GravityTree.GetParticleIndex(k)] = m_GravityTree.Acceleration(glm::vec3(bodies[k]), m_GravityConstant, m_Softening, m_OpeningAngle);
+    });
+}
+
+/**
+ * @brief Integrate the position and velocity of a particle
+ *
+ * @param particle the particle to update
+ * @param attributes the attributes of the particle, the Verlet schemes update the past fields
+ * @param force acceleration of the ForceMode
+ * @param deltaTime time step
+ */
+void CpuSimulator::Integrate(Particle& particle, ParticleAttributes& attributes, const glm::vec3& force, float deltaTime) const
+{
+    if (deltaTime <= 0.0f)
+        return;
+
+    glm::vec3 total = attributes.m_Acceleration + ToVec3(m_Gravity) + force;
+    SimVec acc = ToSimVec(total);
+    bool hasPast = attributes.m_HasPast != 0 && !m_ResetPast;
+
+    if (m_Integrator == Integrator::PositionVerlet)
+    {
+        SimVec current = particle.m_Position;
+        SimVec previous = hasPast ? ToSimVec(attributes.m_PastPosition) : current - particle.m_Velocity * deltaTime;
+        particle.m_Position = 2.0f * current - previous + acc * deltaTime * deltaTime;
+        particle.m_Velocity = (particle.m_Position - current) / deltaTime;
+    }
+    else if (m_Integrator == Integrator::VelocityVerlet)
+    {
+        if (hasPast)
+            particle.m_Velocity += 0.5f * (ToSimVec(attributes.m_PastAcceleration) + acc) * deltaTime;
+        particle.m_Position = particle.m_Position + particle.m_Velocity * deltaTime + ((acc * deltaTime * deltaTime) / 2.0f);
+        attributes.m_PastAcceleration = total;
+        attributes.m_HasPast = 1;
+    }
+    else
+    {
+        particle.m_Position = particle.m_Position + particle.m_Velocity * deltaTime + ((acc * deltaTime * deltaTime) / 2.0f);
+        particle.m_Velocity = acc * deltaTime + particle.m_Velocity;
+    }
+}
+
+/**
+ * @brief Integrate one axis of a chunk of a ParticleSoA
+ *
+ * @param particles the arrays to update
+ * @param axis the axis
+ * @param total acceleration per particle along the axis, with the gravity and the forces
+ * @param begin first particle of the chunk
+ * @param end end of the chunk
+ * @param deltaTime time step, larger than 0
+ *
+ * @details
+ * The same operations per component as Integrate. VelocityVerlet stores the acceleration,
+ * the caller sets the past flags after the last axis.
+ */
+void CpuSimulator::IntegrateAxisSoA(ParticleSoA& particles, int axis, const float* total, size_t begin, size_t end, float deltaTime) const
+{
+    float* pos = particles.Position(axis);
+    float* vel = particles.Velocity(axis);
+    const unsigned int* hasPast = particles.HasPast();
+
+    if (m_Integrator == Integrator::PositionVerlet)
+    {
+        const float* past = particles.PastPosition(axis);
+        for (size_t i = begin; i < end; i++)
+        {
+            float current = pos[i];
+            float previous = hasPast[i] != 0 && !m_ResetPast ? past[i] : current - vel[i] * deltaTime;
+            pos[i] = 2.0f * current - previous + total[i] * deltaTime * deltaTime;
+            vel[i] = (pos[i] - current) / deltaTime;
+        }
+    }
+    else if (m_Integrator == Integrator::VelocityVerlet)
+    {
+        float* past = particles.PastAcceleration(axis);
+        for (size_t i = begin; i < end; i++)
+        {
+            if (hasPast[i] != 0 && !m_ResetPast)
+                vel[i] += 0.5f * (past[i] + total[i]) * deltaTime;
+            pos[i] = pos[i] + vel[i] * deltaTime + ((total[i] * deltaTime * deltaTime) / 2.0f);
+            past[i] = total[i];
+        }
+    }
+    else
+    {
+        IntegrateSoA(pos + begin, vel + begin, total + begin, end - begin, deltaTime);
+    }
+}
+
+/**
+ * @brief Store the position of the last step for the position Verlet integrator
+ *
+ * @param particle the particle after the collisions
+ * @param attributes the attributes of the particle
+ * @param deltaTime time step
+ *
+ * @details
+ * The past position is rebuilt from the velocity, so the velocity changes of the
+ * wall and particle collisions carry over into the next step.
+ */
+void CpuSimulator::SavePastPosition(const Particle& particle, ParticleAttributes& attributes, float deltaTime) const
+{
+    if (m_Integrator != Integrator::PositionVerlet || deltaTime <= 0.0f)
+        return;
+
+    attributes.m_PastPosition = ToVec3(particle.m_Position - particle.m_Velocity * deltaTime);
+    attributes.m_HasPast = 1;
+}
+
+/**
+ * @brief Bounce a particle off the walls of the simulation area
+ *
+ * @param particle the particle to update
+ */
+void CpuSimulator::CheckCollisionWall(Particle& particle) const
+{
+    for (int axis = 0; axis < SIM_DIM; axis++)
+    {
+        if (particle.m_Position[axis] - particle.m_Radius < m_ScreenMin[axis] || particle.m_Position[axis] + particle.m_Radius > m_ScreenMax[axis])
+        {
+            particle.m_Velocity[axis] = -particle.m_Velocity[axis] * m_FrictionW;
+            particle.m_Position[axis] = glm::clamp(particle.m_Position[axis], m_ScreenMin[axis] + particle.m_Radius, m_ScreenMax[axis] - particle.m_Radius);
+        }
+    }
+}
+
+/**
+ * @brief Collide a particle with the particles in the neighbouring cells
+ *
+ * @param pos position of the particle, updated
+ * @param vel velocity of the particle, updated
+ * @param radius radius of the particle
+ * @param index index of the particle in the particlesystem
+ *
+ * @details
+ * The other particles are read from m_SortedPosRadius, which holds their
+ * state after the integration, only the particle itself is written.
+ * Like the collide and apply passes of the shader every contact is tested against
+ * the position before the collisions and the corrections are added at the end,
+ * the neighbours are visited in index order. The result does not depend on the
+ * number of threads.
+ */
+void CpuSimulator::CheckCollisionParticlesGrid(SimVec& pos, SimVec& vel, float radius, unsigned int index) const
+{
+    SimVec correction(0.0f);
+    glm::ivec2 cell = glm::clamp(glm::ivec2(glm::floor((glm::vec2(pos) - m_GridMin) / m_CellSize)), glm::ivec2(0), m_GridDim - 1);
+
+    for (int dy = -1; dy <= 1; dy++)
+    {
+        for (int dx = -1; dx <= 1; dx++)
+        {
+            glm::ivec2 neighbour = cell + glm::ivec2(dx, dy);
+            if (neighbour.x < 0 || neighbour.y < 0 || neighbour.x >= m_GridDim.x || neighbour.y >= m_GridDim.y)
+                continue;
+
+            unsigned int n = neighbour.y * m_GridDim.x + neighbour.x;
+            for (unsigned int k = m_CellStart[n]; k < m_CellStart[n + 1]; k++)
+            {
+                if (m_SortedIndex[k] == index)
+                    continue;
+
+                SimVec diff = pos - ToSimVec(glm::vec3(m_SortedPosRadius[k]));
+                float distance = glm::length(diff);
+                float collisionDistance = radius + m_SortedPosRadius[k].w;
+
+                if (distance < collisionDistance && distance > 0.0f)
+                {
+                    SimVec normal = diff / distance;
+                    vel = glm::reflect(vel, normal) * m_FrictionP;
+
+                    float overlap = 0.5f * (collisionDistance - distance);
+                    correction += normal * overlap;
+                }
+            }
+        }
+    }
+
+    pos += correction;
+}
+
+/**
+ * @brief Get the grid cell of a position
+ *
+ * @param pos the position
+ * @return unsigned int index of the cell
+ */
+unsigned int CpuSimulator::CellIndex(const SimVec& pos) const
+{
+    glm::ivec2 cell = glm::clamp(glm::ivec2(glm::floor((glm::vec2(pos) - m_GridMin) / m_CellSize)), glm::ivec2(0), m_GridDim - 1);
+    return cell.y * m_GridDim.x + cell.x;
+}
+
+/**
+ * @brief Counting sort of the particles by grid cell
+ *
+ * @param count number of particles
+ *
+ * @details
+ * Fill m_CellStart and m_SortedIndex from m_CellOf and size m_SortedPosRadius.
+ * Particles within a cell keep their index order.
+ */
+void CpuSimulator::SortByCell(size_t count)
+{
+    std::fill(m_CellStart.begin(), m_CellStart.end(), 0);
+    for (size_t i = 0; i < count; i++)
+        m_CellStart[m_CellOf[i] + 1]++;
+
+    for (size_t c = 1; c < m_CellStart.size(); c++)
+        m_CellStart[c] += m_CellStart[c - 1];
+
+    // m_CellStart[c] is used as the insert position of cell c and ends at the start of cell c + 1
+    m_SortedIndex.resize(count);
+    m_SortedPosRadius.resize(count);
+    for (size_t i = 0; i < count; i++)
+        m_SortedIndex[m_CellStart[m_CellOf[i]]++] = (unsigned int)i;
+
+    for (size_t c = m_CellStart.size() - 1; c > 0; c--)
+        m_CellStart[c] = m_CellStart[c - 1];
+    m_CellStart[0] = 0;
+}
@@ -0,0 +1,132 @@
+/**
+ * @file CpuSimulator.h
+ * @brief This file contains the CpuSimulator class and its methods.
+ *
+ * @details This file contains the CpuSimulator class, a cpu backend for the
+ * simulation step of Compute.glsl. It runs without an OpenGL context, so the
+ * simulation can run headless on machines without a gpu.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Particlesystem.h"
+#include "ParticleSoA.h"
+#include "ThreadPool.h"
+#include "BarnesHutTree.h"
+#include "ParticleMesh.h"
+#include "MortonOrder.h"
+
+/**
+ * @class CpuSimulator
+ * @brief Multithreaded cpu implementation of the simulation step
+ *
+ * @details
+ * The CpuSimulator has the same Update interface as ComputeShader and works directly
+ * on ParticleSystem::data(), so no upload or retrieve is needed. The integration, the
+ * wall collisions and the grid based particle collisions are ported from Compute.glsl
+ * and split over all cores with a ThreadPool.
+ *
+ * The particle collisions read the other particles from a copy sorted by grid cell
+ * and only write the particle itself, so the threads never write shared data and
+ * a step gives the same bits at every thread count.
+ *
+ * Update also accepts a ParticleSoA and gives the same bits as for a ParticleSystem,
+ * then the Euler integration and the wall collisions run as SIMD kernels over the
+ * separate arrays.
+ *
+ * In ForceMode::BarnesHut every step starts with building a BarnesHutTree of the
+ * particles and the gravitational acceleration of every particle, in parallel.
+ * In ForceMode::ParticleMesh a ParticleMesh over the walls solves the potential instead,
+ * in ForceMode::AllPairs every particle sums the gravity of all other particles.
+ *
+ * Every SetReorderInterval steps Update sorts the particles of the ParticleSystem along
+ * the Morton curve with a MortonOrder, like ComputeShader, so neighbouring particles are
+ * neighbours in memory. A ParticleSoA keeps the order of its Gather, Scatter needs it.
+ *
+ * Like the shader it only handles the SIM_DIM axes of the particles.
+ */
+class CpuSimulator
+{
+public:
+	CpuSimulator(unsigned int threadCount = 0);
+	~CpuSimulator();
+
+	void initGrid(const glm::vec2& boundsMin, const glm::vec2& boundsMax, float cellSize);
+	void Update(ParticleSystem& particlesystem, float deltaTime);
+	void Update(ParticleSoA& particles, float deltaTime);
+
+	void SetIntegrator(Integrator integrator);
+	Integrator GetIntegrator() const { return m_Integrator; }
+
+	void SetBounds(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+	void SetFriction(float wall, float particle);
+	void SetGravity(const glm::vec3& gravity) { m_Gravity = ToSimVec(gravity); }
+	void SetGravitation(float gravityConstant, float softening, float openingAngle);
+
+	void SetForceMode(ForceMode mode) { m_ForceMode = mode; }
+	ForceMode GetForceMode() const { return m_ForceMode; }
+
+	bool SetMeshSize(unsigned int cells);
+	unsigned int GetMeshSize() const { return m_MeshCells; }
+
+	void SetReorderInterval(unsigned int steps) { m_ReorderInterval = steps; }	///< steps between two reorders, 0 never reorders
+	unsigned int GetReorderInterval() const { return m_ReorderInterval; }
+
+	unsigned int GetThreadCount() const { return m_ThreadPool.GetThreadCount(); }
+
+private:
+	void ComputeForces(size_t count);
+	void Integrate(Particle& particle, ParticleAttributes& attributes, const glm::vec3& force, float deltaTime) const;
+	void IntegrateAxisSoA(ParticleSoA& particles, int axis, const float* total, size_t begin, size_t end, float deltaTime) const;
+	void SavePastPosition(const Particle& particle, ParticleAttributes& attributes, float deltaTime) const;
+	void CheckCollisionWall(Particle& particle) const;
+	void CheckCollisionParticlesGrid(SimVec& pos, SimVec& vel, float radius, unsigned int index) const;
+
+	unsigned int CellIndex(const SimVec& pos) const;
+	void SortByCell(size_t count);
+
+	ThreadPool m_ThreadPool;
+
+	SimVec m_ScreenMin = ToSimVec({ -0.5f, -0.5f, 0.0f });	///< same defaults as SimParams
+	SimVec m_ScreenMax = ToSimVec({ 800.0f, 600.0f, 0.0f });
+	float m_FrictionW = 0.95f;
+	float m_FrictionP = 0.96f;
+	SimVec m_Gravity = SimVec(0.0f);
+	float m_GravityConstant = 1.0f;
+	float m_Softening = 1.0f;
+	float m_OpeningAngle = 0.5f;
+
+	ForceMode m_ForceMode = ForceMode::None;
+	BarnesHutTree m_GravityTree;
+	ParticleMesh m_ParticleMesh;
+	unsigned int m_MeshCells = ParticleMesh::DEFAULT_CELLS;
+	std::vector<glm::vec4> m_Bodies;				///< position and mass per particle for ForceMode::AllPairs
+	std::vector<glm::vec3> m_Forces;				///< acceleration of the ForceMode per particle
+	AlignedVector<float> m_TotalAcceleration;		///< acceleration, gravity and forces along one axis per particle of a ParticleSoA
+
+	MortonOrder m_MortonOrder;
+	unsigned int m_ReorderInterval = 0;
+	unsigned int m_StepsSinceReorder = 0;
+
+	Integrator m_Integrator = Integrator::Euler;
+	bool m_ResetPast = false;		///< the past fields belong to another integrator, ignore them for one step
+
+	glm::vec2 m_GridMin;
+	glm::ivec2 m_GridDim;
+	float m_CellSize;
+
+	std::vector<unsigned int> m_CellOf;				///< cell of every particle
+	std::vector<unsigned int> m_CellStart;			///< index of the first particle of a cell, one extra entry for the end
+	std::vector<unsigned int> m_SortedIndex;		///< particle indices ordered by cell
+	std::vector<glm::vec4> m_SortedPosRadius;		///< position and radius in the same order as m_SortedIndex
+};
@@ -0,0 +1,176 @@
+/**
+ * @file Fft.cpp
+ * @brief This file contains the implementation for the Fft class.
+ *
+ * @details This file contains the method definitions for the complex and real
+ * fast Fourier transforms. FftShared, MeshRows and MeshInverseRows in Compute.glsl
+ * mirror them.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "Fft.h"
+
+#include <cmath>
+#include <utility>
+
+static const double PI = 3.14159265358979323846;
+
+/**
+ * @brief Constructor
+ *
+ * @param size number of complex points, a power of two
+ */
+Fft::Fft(size_t size)
+    : m_Size(0)
+{
+    Resize(size);
+}
+
+/**
+ * @brief Destructor
+ */
+Fft::~Fft()
+{
+}
+
+/**
+ * @brief Compute the tables of another size
+ *
+ * @param size number of complex points, a power of two
+ */
+void Fft::Resize(size_t size)
+{
+    m_Size = size;
+    m_Twiddles.resize(size / 2);
+    m_RealTwiddles.resize(size / 2 + 1);
+    m_Reverse.resize(size);
+
+    for (size_t k = 0; k < m_Twiddles.size(); k++)
+        m_Twiddles[k] = std::complex<float>(std::polar(1.0, -2.0 * PI * k / size));
+    for (size_t k = 0; k < m_RealTwiddles.size(); k++)
+        m_RealTwiddles[k] = std::complex<float>(std::polar(1.0, -PI * k / size));
+
+    unsigned int bits = 0;
+    while (((size_t)1 << bits) < size)
+        bits++;
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned int reversed = 0;
+        for (unsigned int bit = 0; bit < bits; bit++)
+            reversed |= (unsigned int)((i >> bit) & 1) << (bits - 1 - bit);
+        m_Reverse[i] = reversed;
+    }
+}
+
+/**
+ * @brief Transform size() complex points in place
+ *
+ * @param data the points
+ * @param inverse the inverse transform, divided by size()
+ */
+void Fft::Transform(std::complex<float>* data, bool inverse) const
+{
+    for (size_t i = 0; i < m_Size; i++)
+    {
+        if (i < m_Reverse[i])
+            std::swap(data[i], data[m_Reverse[i]]);
+    }
+
+    for (size_t length = 2; length <= m_Size; length <<= 1)
+    {
+        size_t half = length / 2;
+        size_t step = m_Size / length;
+        for (size_t base = 0; base < m_Size; base += length)
+        {
+            for (size_t k = 0; k < half; k++)
+            {
+                std::complex<float> w = inverse ? std::conj(m_Twiddles[k * step]) : m_Twiddles[k * step];
+                std::complex<float> u = data[base + k];
+                std::complex<float> v = data[base + k + half] * w;
+                data[base + k] = u + v;
+                data[base + k + half] = u - v;
+            }
+        }
+    }
+
+    if (inverse)
+    {
+        float scale = 1.0f / m_Size;
+        for (size_t i = 0; i < m_Size; i++)
+            data[i] *= scale;
+    }
+}
+
+/**
+ * @brief Transform 2 * size() real points
+ *
+ * @param input the real points
+ * @param output size() + 1 complex points, the frequencies 0 to size()
+ *
+ * @details
+ * The even and odd samples are transformed together as z = even + i odd.
+ * For every frequency k the transforms of both are separated with the symmetry
+ * of real transforms, E = (Z[k] + conj Z[M-k]) / 2 and O = (Z[k] - conj Z[M-k]) / 2i,
+ * and combined as X[k] = E + e^(-2 pi i k / 2M) O.
+ */
+void Fft::RealForward(const float* input, std::complex<float>* output) const
+{
+    const size_t m = m_Size;
+    for (size_t n = 0; n < m; n++)
+        output[n] = std::complex<float>(input[2 * n], input[2 * n + 1]);
+    Transform(output, false);
+
+    std::complex<float> z0 = output[0];
+    output[0] = std::complex<float>(z0.real() + z0.imag(), 0.0f);
+    output[m] = std::complex<float>(z0.real() - z0.imag(), 0.0f);
+
+    // the frequencies k and M - k use the same two points, compute them together
+    for (size_t k = 1; k <= m / 2; k++)
+    {
+        std::complex<float> a = output[k];
+        std::complex<float> b = std::conj(output[m - k]);
+        std::complex<float> even = 0.5f * (a + b);
+        std::complex<float> odd = std::complex<float>(0.0f, -0.5f) * (a - b);
+        std::complex<float> twiddled = m_RealTwiddles[k] * odd;
+
+        output[k] = even + twiddled;
+        output[m - k] = std::conj(even - twiddled);
+    }
+}
+
+/**
+ * @brief Inverse of RealForward
+ *
+ * @param input size() + 1 complex points, overwritten
+ * @param output 2 * size() real points
+ */
+void Fft::RealInverse(std::complex<float>* input, float* output) const
+{
+    const size_t m = m_Size;
+    float x0 = input[0].real();
+    float xm = input[m].real();
+    input[0] = std::complex<float>(0.5f * (x0 + xm), 0.5f * (x0 - xm));
+
+    for (size_t k = 1; k <= m / 2; k++)
+    {
+        std::complex<float> a = input[k];
+        std::complex<float> b = std::conj(input[m - k]);
+        std::complex<float> even = 0.5f * (a + b);
+        std::complex<float> odd = 0.5f * (a - b) * std::conj(m_RealTwiddles[k]);
+
+        input[k] = even + std::complex<float>(0.0f, 1.0f) * odd;
+        input[m - k] = std::conj(even) + std::complex<float>(0.0f, 1.0f) * std::conj(odd);
+    }
+
+    Transform(input, true);
+    for (size_t n = 0; n < m; n++)
+    {
+        output[2 * n] = input[n].real();
+        output[2 * n + 1] = input[n].imag();
+    }
+}
@@ -0,0 +1,53 @@
+/**
+ * @file Fft.h
+ * @brief This file contains the Fft class and its methods.
+ *
+ * @details This file contains the Fft class, a radix-2 fast Fourier transform of
+ * complex and real sequences, used by the ParticleMesh force solver.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include <complex>
+#include <vector>
+
+/**
+ * @class Fft
+ * @brief Radix-2 fast Fourier transform of one size
+ *
+ * @details
+ * Transform is an in place iterative Cooley-Tukey transform of size() complex points,
+ * the twiddle factors and the bit reversal are computed once by the constructor.
+ * The inverse transform includes the 1 / size() normalisation.
+ *
+ * RealForward and RealInverse transform 2 * size() real points with one complex
+ * transform of size(): the even and odd samples are packed as the real and imaginary
+ * parts and separated afterwards. The spectrum of a real sequence is symmetric, only
+ * its size() + 1 non negative frequencies are stored. Compute.glsl runs the same
+ * steps in shared memory.
+ */
+class Fft
+{
+public:
+	Fft(size_t size = 0);
+	~Fft();
+
+	void Resize(size_t size);
+	size_t size() const { return m_Size; }
+
+	void Transform(std::complex<float>* data, bool inverse) const;
+	void RealForward(const float* input, std::complex<float>* output) const;
+	void RealInverse(std::complex<float>* input, float* output) const;
+
+private:
+	size_t m_Size;								///< complex points, a power of two
+	std::vector<std::complex<float>> m_Twiddles;	///< e^(-2 pi i k / m_Size) for k < m_Size / 2
+	std::vector<std::complex<float>> m_RealTwiddles;	///< e^(-2 pi i k / (2 m_Size)) for k <= m_Size / 2
+	std::vector<unsigned int> m_Reverse;		///< bit reversed index
+};
@@ -0,0 +1,88 @@
+/**
+ * @file FixedTimestep.cpp
+ * @brief This file contains the implementation for the FixedTimestep class.
+ *
+ * @details This file contains the method definitions for turning measured
+ * frame times into a number of fixed simulation steps.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "FixedTimestep.h"
+
+#include <cmath>
+
+constexpr float FixedTimestep::MAX_FRAME_TIME;
+
+/**
+ * @brief Constructor
+ *
+ * @param stepSize simulated time per step in seconds
+ * @param maxSteps cap on the steps per frame
+ */
+FixedTimestep::FixedTimestep(float stepSize, unsigned int maxSteps)
+    : m_StepSize(stepSize > 0.0f ? stepSize : 0.01f), m_MaxSteps(maxSteps > 0 ? maxSteps : 1)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+FixedTimestep::~FixedTimestep()
+{
+}
+
+/**
+ * @brief Add the time of a frame and get the number of steps to simulate
+ *
+ * @param frameTime measured time since the last call in seconds
+ * @return unsigned int number of steps of GetStepSize, at most GetMaxSteps
+ *
+ * @details
+ * Negative frame times are ignored and frame times are clamped to MAX_FRAME_TIME.
+ * Time that does not fit in the step cap is dropped, so the accumulator is always
+ * less than one step when Advance returns.
+ */
+unsigned int FixedTimestep::Advance(float frameTime)
+{
+    if (frameTime < 0.0f) { frameTime = 0.0f; }
+    if (frameTime > MAX_FRAME_TIME) { frameTime = MAX_FRAME_TIME; }
+
+    m_Accumulator += frameTime;
+
+    unsigned int steps = 0;
+    while (m_Accumulator >= m_StepSize && steps < m_MaxSteps)
+    {
+        m_Accumulator -= m_StepSize;
+        steps++;
+    }
+
+    if (m_Accumulator >= m_StepSize)
+    {
+        float kept = std::fmod(m_Accumulator, m_StepSize);
+        m_DroppedTime += m_Accumulator - kept;
+        m_Accumulator = kept;
+    }
+
+    return steps;
+}
+
+/**
+ * @brief Change the simulated time per step
+ *
+ * @param stepSize simulated time per step in seconds, must be positive
+ *
+ * @details
+ * The accumulated time is kept, the next Advance splits it into steps of the new size.
+ */
+void FixedTimestep::SetStepSize(float stepSize)
+{
+    if (stepSize <= 0.0f)
+        return;
+
+    m_StepSize = stepSize;
+}
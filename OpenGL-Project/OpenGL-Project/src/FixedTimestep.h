@@ -0,0 +1,53 @@
+/**
+ * @file FixedTimestep.h
+ * @brief This file contains the FixedTimestep class and its methods.
+ *
+ * @details This file contains the FixedTimestep class which decouples the
+ * simulation step from the frame rate of the main loop.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+/**
+ * @class FixedTimestep
+ * @brief Accumulator that turns measured frame times into fixed simulation steps
+ *
+ * @details
+ * Every frame the measured frame time is added to an accumulator and Advance returns
+ * how many steps of GetStepSize fit in it, the rest carries over to the next frame.
+ * So the simulation runs at the same speed at every frame rate.
+ *
+ * At most m_MaxSteps steps run per frame. When a frame needs more, the simulation
+ * falls behind instead of spending even longer on the next frame (spiral of death),
+ * the time that does not fit is dropped and counted in GetDroppedTime.
+ */
+class FixedTimestep
+{
+public:
+	FixedTimestep(float stepSize = 0.01f, unsigned int maxSteps = 8);
+	~FixedTimestep();
+
+	unsigned int Advance(float frameTime);
+
+	float GetStepSize() const { return m_StepSize; }
+	void SetStepSize(float stepSize);
+	unsigned int GetMaxSteps() const { return m_MaxSteps; }
+	void SetMaxSteps(unsigned int maxSteps) { m_MaxSteps = maxSteps > 0 ? maxSteps : 1; }
+
+	float GetAlpha() const { return m_Accumulator / m_StepSize; }
+	float GetDroppedTime() const { return m_DroppedTime; }
+
+	static constexpr float MAX_FRAME_TIME = 0.25f;	///< longer frames, like a breakpoint or a moved window, count as this
+
+private:
+	float m_StepSize;			///< simulated time per step in seconds
+	unsigned int m_MaxSteps;	///< cap on the steps per frame
+	float m_Accumulator = 0.0f;	///< measured time not simulated yet, less than one step after Advance
+	float m_DroppedTime = 0.0f;	///< total time dropped by the cap
+};
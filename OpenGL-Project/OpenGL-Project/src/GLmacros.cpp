@@ -15,6 +15,76 @@
 
 #include <iostream>
 
+/// Source, type or severity of a debug message as text
+static const char* DebugSourceName(GLenum source)
+{
+    switch (source)
+    {
+    case GL_DEBUG_SOURCE_API: return "API";
+    case GL_DEBUG_SOURCE_WINDOW_SYSTEM: return "window system";
+    case GL_DEBUG_SOURCE_SHADER_COMPILER: return "shader compiler";
+    case GL_DEBUG_SOURCE_THIRD_PARTY: return "third party";
+    case GL_DEBUG_SOURCE_APPLICATION: return "application";
+    default: return "other";
+    }
+}
+
+static const char* DebugTypeName(GLenum type)
+{
+    switch (type)
+    {
+    case GL_DEBUG_TYPE_ERROR: return "error";
+    case GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR: return "deprecated";
+    case GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR: return "undefined behaviour";
+    case GL_DEBUG_TYPE_PORTABILITY: return "portability";
+    case GL_DEBUG_TYPE_PERFORMANCE: return "performance";
+    default: return "other";
+    }
+}
+
+static const char* DebugSeverityName(GLenum severity)
+{
+    switch (severity)
+    {
+    case GL_DEBUG_SEVERITY_HIGH: return "high";
+    case GL_DEBUG_SEVERITY_MEDIUM: return "medium";
+    case GL_DEBUG_SEVERITY_LOW: return "low";
+    default: return "notification";
+    }
+}
+
+/// A GLCall is running, set by GlEnterCall and GlLeaveCall on the thread of the context
+static bool s_InGLCall = false;
+
+/// Message ids that only describe normal driver behaviour, like NVIDIA buffer placement info
+static const GLuint IGNORED_MESSAGES[] = { 131169, 131185, 131204 };
+
+/**
+ * @brief Receives the messages of the KHR_debug output
+ *
+ * @details
+ * In the GL_DEBUG_SYNC mode the callback runs inside the failing call, so the
+ * debug break on an error stops with the call on the stack. Only errors inside a
+ * GLCall break, other calls may raise an error on purpose and recover.
+ */
+static void GLAPIENTRY GlDebugCallback(GLenum source, GLenum type, GLuint id, GLenum severity,
+    GLsizei length, const GLchar* message, const void* userParam)
+{
+    for (GLuint ignored : IGNORED_MESSAGES)
+    {
+        if (id == ignored)
+            return;
+    }
+
+    std::cout << "[OpenGL " << DebugTypeName(type) << "] (" << id << ", " << DebugSourceName(source)
+        << ", " << DebugSeverityName(severity) << "): " << message << std::endl;
+
+#if GL_DEBUG_MODE == GL_DEBUG_SYNC
+    if (type == GL_DEBUG_TYPE_ERROR && s_InGLCall)
+        DEBUG_BREAK();
+#endif
+}
+
 /**
  * @brief Clears the OpenGL error buffer.
  * 
@@ -26,6 +96,22 @@ void GlClearError()
     while (glGetError() != GL_NO_ERROR);
 }
 
+/**
+ * @brief Marks the start of the call of a GLCall, errors in the debug callback break
+ */
+void GlEnterCall()
+{
+    s_InGLCall = true;
+}
+
+/**
+ * @brief Marks the end of the call of a GLCall
+ */
+void GlLeaveCall()
+{
+    s_InGLCall = false;
+}
+
 /**
  * @brief Logs an OpenGL error.
  * 
@@ -45,4 +131,30 @@ bool GlLogCall(const char* function, const char* file, int line)
         return false;
     }
     return true;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Install the debug output of the GL_DEBUG_MODE, call once after glewInit.
+ * 
+ * @details In the GL_DEBUG_CALLBACK and GL_DEBUG_SYNC modes the KHR_debug callback is
+ *         installed and notifications are filtered out, in the GL_DEBUG_SYNC mode the
+ *         output is also made synchronous. Without KHR_debug the GL_DEBUG_CALLBACK mode
+ *         reports nothing, the GL_DEBUG_SYNC mode still checks every GLCall.
+ */
+void GlInitDebugOutput()
+{
+#if GL_DEBUG_MODE != GL_DEBUG_OFF
+    if (!(GLEW_VERSION_4_3 || GLEW_KHR_debug))
+    {
+        std::cout << "KHR_debug is not supported, OpenGL errors are not reported by the driver." << std::endl;
+        return;
+    }
+
+    glEnable(GL_DEBUG_OUTPUT);
+#if GL_DEBUG_MODE == GL_DEBUG_SYNC
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+#endif
+    glDebugMessageCallback(GlDebugCallback, nullptr);
+    glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DEBUG_SEVERITY_NOTIFICATION, 0, nullptr, GL_FALSE);
+#endif
+}
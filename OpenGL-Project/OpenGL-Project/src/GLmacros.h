@@ -3,6 +3,7 @@
  * @brief Implements the GLmacros class for managing OpenGL error handling.
  *
  * @details This file includes the functions and macros for handling OpenGL errors.
+ * GL_DEBUG_MODE selects how errors are found, see GlInitDebugOutput.
  *
  * For more information, see the documentation at:
  * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
@@ -15,14 +16,45 @@
 
 #include "GL/glew.h"
 
+#include <csignal>
+
+/// No checks, GLCall is the bare call
+#define GL_DEBUG_OFF 0
+/// Errors are reported asynchronously by the driver through a KHR_debug callback
+#define GL_DEBUG_CALLBACK 1
+/// Every GLCall checks glGetError and the callback runs on the calling thread
+#define GL_DEBUG_SYNC 2
+
+/**
+ * @brief How OpenGL errors are found, one of the GL_DEBUG_ modes
+ *
+ * @details
+ * Debug builds check every call, release builds only install the callback so the
+ * hot loops never wait for the driver. Set it in the project settings to override.
+ */
+#ifndef GL_DEBUG_MODE
+#ifdef NDEBUG
+#define GL_DEBUG_MODE GL_DEBUG_CALLBACK
+#else
+#define GL_DEBUG_MODE GL_DEBUG_SYNC
+#endif
+#endif
+
+/**
+ * @brief Stops in the debugger, on Windows with `__debugbreak()` and elsewhere with SIGTRAP.
+ */
+#if defined(_MSC_VER)
+#define DEBUG_BREAK() __debugbreak()
+#else
+#define DEBUG_BREAK() std::raise(SIGTRAP)
+#endif
+
 /**
  * @brief Asserts a condition and triggers a debug break if the condition is false.
  * 
  * @param x The condition to check.
- * 
- * @note This macro uses the `__debugbreak()` function, which is platform-specific and typically works on Windows.
  */
-#define ASSERT(x) if (!(x)) __debugbreak();
+#define ASSERT(x) do { if (!(x)) DEBUG_BREAK(); } while (0)
 
 /**
  * @brief Calls a specified OpenGL function after clearing any existing OpenGL errors, 
@@ -30,12 +62,27 @@
  * 
  * @param x The OpenGL function to call.
  * 
- * @note This macro ensures that OpenGL errors are logged and handled. It requires 
- *       `GlClearError()` and `GlLogCall()` to be implemented.
+ * @note Only in the GL_DEBUG_SYNC mode, the other modes call the function without
+ *       checks. The statements are not wrapped, so a declaration like
+ *       `GLCall(int location = ...)` stays visible after the macro.
+ *
+ * @note In the GL_DEBUG_SYNC mode the debug callback only breaks on an error raised
+ *       inside a GLCall. Calls outside GLCall, like probes that may fail and recover,
+ *       only log their errors. Those must clear the error with GlClearError, and should
+ *       rather check up front so no error is raised, see ProgramCache::Load.
  */
+#if GL_DEBUG_MODE == GL_DEBUG_SYNC
 #define GLCall(x) GlClearError();\
+    GlEnterCall();\
     x;\
+    GlLeaveCall();\
     ASSERT(GlLogCall(#x, __FILE__, __LINE__))
+#else
+#define GLCall(x) x
+#endif
 
 void GlClearError();
-bool GlLogCall(const char* function, const char* file, int line);
\ No newline at end of file
+void GlEnterCall();
+void GlLeaveCall();
+bool GlLogCall(const char* function, const char* file, int line);
+void GlInitDebugOutput();
@@ -0,0 +1,314 @@
+/**
+ * @file GpuProfiler.cpp
+ * @brief This file contains the implementation for the GpuProfiler class.
+ *
+ * @details This file contains the method definitions for timing the stages of a
+ * frame, the ImGui overlay and the Chrome trace export.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "GpuProfiler.h"
+
+#include "GLmacros.h"
+#include "imgui/imgui.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+
+constexpr unsigned int GpuProfiler::FRAME_LATENCY;
+constexpr unsigned int GpuProfiler::HISTORY;
+constexpr size_t GpuProfiler::MAX_TRACE_EVENTS;
+
+/**
+ * @brief Constructor
+ */
+GpuProfiler::GpuProfiler()
+    : m_Start(std::chrono::steady_clock::now()), m_FrameIndex(0), m_DroppedFrames(0), m_TraceNext(0)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+GpuProfiler::~GpuProfiler()
+{
+    for (Frame& frame : m_Frames)
+    {
+        if (!frame.queries.empty())
+        {
+            GLCall(glDeleteQueries((GLsizei)frame.queries.size(), frame.queries.data()));
+        }
+    }
+}
+
+/**
+ * @brief Start a new frame
+ *
+ * @details
+ * Reads the queries of the frame FRAME_LATENCY frames ago, which used the same slot.
+ * The stages that are still running are ended first.
+ */
+void GpuProfiler::BeginFrame()
+{
+    while (!m_Open.empty())
+        End();
+
+    m_FrameIndex++;
+    Frame& frame = m_Frames[m_FrameIndex % FRAME_LATENCY];
+    Resolve(frame);
+    frame.intervals.clear();
+    frame.lastQuery = 0;
+}
+
+/**
+ * @brief Start timing a stage
+ *
+ * @param stage name of the stage, the same name sums into the same row
+ *
+ * @details
+ * May be called while another stage runs, the new stage then runs inside it.
+ */
+void GpuProfiler::Begin(const char* stage)
+{
+    Frame& frame = m_Frames[m_FrameIndex % FRAME_LATENCY];
+    if (2 * frame.intervals.size() == frame.queries.size())
+    {
+        GLuint queries[2] = { 0, 0 };
+        GLCall(glGenQueries(2, queries));
+        frame.queries.insert(frame.queries.end(), queries, queries + 2);
+    }
+
+    Interval interval;
+    interval.stage = StageIndex(stage);
+    interval.beginQuery = frame.queries[2 * frame.intervals.size()];
+    interval.endQuery = frame.queries[2 * frame.intervals.size() + 1];
+    interval.cpuBegin = Now();
+    interval.cpuEnd = interval.cpuBegin;
+    m_Open.push_back(frame.intervals.size());
+    frame.intervals.push_back(interval);
+
+    GLCall(glQueryCounter(interval.beginQuery, GL_TIMESTAMP));
+    frame.lastQuery = interval.beginQuery;
+}
+
+/**
+ * @brief Stop timing the stage of the last Begin that is still running
+ */
+void GpuProfiler::End()
+{
+    if (m_Open.empty())
+        return;
+
+    Frame& frame = m_Frames[m_FrameIndex % FRAME_LATENCY];
+    Interval& interval = frame.intervals[m_Open.back()];
+    m_Open.pop_back();
+
+    GLCall(glQueryCounter(interval.endQuery, GL_TIMESTAMP));
+    frame.lastQuery = interval.endQuery;
+    interval.cpuEnd = Now();
+}
+
+/**
+ * @brief Add the times of a finished frame to the history and the trace
+ *
+ * @param frame the frame to read
+ *
+ * @details
+ * The queries finish in order, so when the last one is available all of them are.
+ * Otherwise the frame is dropped, reading it would wait for the gpu.
+ *
+ * The timestamps have no common origin with the cpu clock, so the gpu events of the
+ * trace keep their offset to the first stage of the frame and start at its cpu time.
+ */
+void GpuProfiler::Resolve(Frame& frame)
+{
+    if (frame.intervals.empty())
+        return;
+
+    GLuint available = GL_FALSE;
+    GLCall(glGetQueryObjectuiv(frame.lastQuery, GL_QUERY_RESULT_AVAILABLE, &available));
+    if (available == GL_FALSE)
+    {
+        m_DroppedFrames++;
+        return;
+    }
+
+    std::vector<double> cpu(m_Stages.size(), 0.0);
+    std::vector<double> gpu(m_Stages.size(), 0.0);
+    std::vector<bool> ran(m_Stages.size(), false);
+
+    GLuint64 frameBegin = 0;
+    GLCall(glGetQueryObjectui64v(frame.intervals.front().beginQuery, GL_QUERY_RESULT, &frameBegin));
+
+    for (const Interval& interval : frame.intervals)
+    {
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        GLCall(glGetQueryObjectui64v(interval.beginQuery, GL_QUERY_RESULT, &begin));
+        GLCall(glGetQueryObjectui64v(interval.endQuery, GL_QUERY_RESULT, &end));
+
+        double cpuDuration = interval.cpuEnd - interval.cpuBegin;
+        double gpuDuration = end > begin ? (end - begin) / 1000.0 : 0.0;
+        double gpuBegin = frame.intervals.front().cpuBegin + (begin > frameBegin ? (begin - frameBegin) / 1000.0 : 0.0);
+        cpu[interval.stage] += cpuDuration;
+        gpu[interval.stage] += gpuDuration;
+        ran[interval.stage] = true;
+
+        TraceEvent events[2] = { { interval.stage, false, interval.cpuBegin, cpuDuration }, { interval.stage, true, gpuBegin, gpuDuration } };
+        for (const TraceEvent& event : events)
+        {
+            if (m_Trace.size() < MAX_TRACE_EVENTS)
+                m_Trace.push_back(event);
+            else
+                m_Trace[m_TraceNext] = event;
+            m_TraceNext = (m_TraceNext + 1) % MAX_TRACE_EVENTS;
+        }
+    }
+
+    for (size_t i = 0; i < m_Stages.size(); i++)
+    {
+        if (!ran[i])
+            continue;
+
+        Stage& stage = m_Stages[i];
+        if (stage.cpu.size() < HISTORY)
+        {
+            stage.cpu.push_back((float)(cpu[i] / 1000.0));
+            stage.gpu.push_back((float)(gpu[i] / 1000.0));
+        }
+        else
+        {
+            stage.cpu[stage.next] = (float)(cpu[i] / 1000.0);
+            stage.gpu[stage.next] = (float)(gpu[i] / 1000.0);
+        }
+        stage.next = (stage.next + 1) % HISTORY;
+    }
+}
+
+/**
+ * @brief Percentile of the time per frame of a stage
+ *
+ * @param stage name of the stage
+ * @param gpu the gpu time instead of the cpu time
+ * @param p fraction between 0 and 1, 0.5 for the median
+ * @return float milliseconds, 0 when the stage has no history
+ */
+float GpuProfiler::GetPercentile(const char* stage, bool gpu, float p) const
+{
+    for (const Stage& candidate : m_Stages)
+    {
+        if (candidate.name != stage)
+            continue;
+
+        std::vector<float> times = gpu ? candidate.gpu : candidate.cpu;
+        if (times.empty())
+            return 0.0f;
+
+        size_t index = std::min((size_t)(p * (times.size() - 1) + 0.5f), times.size() - 1);
+        std::nth_element(times.begin(), times.begin() + index, times.end());
+        return times[index];
+    }
+    return 0.0f;
+}
+
+/**
+ * @brief Show the p50 and p99 of every stage as an ImGui table
+ *
+ * @details
+ * Call inside an ImGui window. The button writes the trace to profile_trace.json.
+ */
+void GpuProfiler::OnImGuiRender()
+{
+    if (ImGui::BeginTable("Profiler", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit))
+    {
+        ImGui::TableSetupColumn("Stage (ms)");
+        ImGui::TableSetupColumn("cpu p50");
+        ImGui::TableSetupColumn("cpu p99");
+        ImGui::TableSetupColumn("gpu p50");
+        ImGui::TableSetupColumn("gpu p99");
+        ImGui::TableHeadersRow();
+
+        for (const Stage& stage : m_Stages)
+        {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn(); ImGui::Text("%s", stage.name.c_str());
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", GetPercentile(stage.name.c_str(), false, 0.5f));
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", GetPercentile(stage.name.c_str(), false, 0.99f));
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", GetPercentile(stage.name.c_str(), true, 0.5f));
+            ImGui::TableNextColumn(); ImGui::Text("%.3f", GetPercentile(stage.name.c_str(), true, 0.99f));
+        }
+        ImGui::EndTable();
+    }
+    ImGui::Text("Frames dropped: %u", m_DroppedFrames);
+
+    if (ImGui::Button("Export Chrome trace"))
+        ExportChromeTrace("profile_trace.json");
+}
+
+/**
+ * @brief Write the recorded stages in the Chrome trace event format
+ *
+ * @param filepath the json file, open it in chrome://tracing or Perfetto
+ * @return true when the file was written
+ *
+ * @details
+ * The cpu times are on thread 1 and the gpu times on thread 2.
+ */
+bool GpuProfiler::ExportChromeTrace(const std::string& filepath) const
+{
+    std::ofstream file(filepath);
+    if (!file)
+    {
+        std::cerr << "Can not write " << filepath << std::endl;
+        return false;
+    }
+
+    file << std::fixed << std::setprecision(3);     ///< microseconds, the default precision rounds after a second
+    file << "{\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+    size_t oldest = m_Trace.size() < MAX_TRACE_EVENTS ? 0 : m_TraceNext;
+    for (size_t i = 0; i < m_Trace.size(); i++)
+    {
+        const TraceEvent& event = m_Trace[(oldest + i) % m_Trace.size()];
+        file << ",\n{\"name\":\"" << m_Stages[event.stage].name << "\",\"cat\":\"" << (event.gpu ? "gpu" : "cpu")
+            << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << (event.gpu ? 2 : 1)
+            << ",\"ts\":" << event.begin << ",\"dur\":" << event.duration << "}";
+    }
+    file << "\n]}\n";
+
+    std::cout << "Wrote " << m_Trace.size() << " trace events to " << filepath << std::endl;
+    return true;
+}
+
+/**
+ * @brief Index of a stage in m_Stages, adds it the first time
+ */
+unsigned int GpuProfiler::StageIndex(const char* stage)
+{
+    for (size_t i = 0; i < m_Stages.size(); i++)
+    {
+        if (m_Stages[i].name == stage)
+            return (unsigned int)i;
+    }
+
+    m_Stages.emplace_back();
+    m_Stages.back().name = stage;
+    return (unsigned int)m_Stages.size() - 1;
+}
+
+/**
+ * @brief Microseconds since the profiler was created
+ */
+double GpuProfiler::Now() const
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_Start).count();
+}
@@ -0,0 +1,132 @@
+/**
+ * @file GpuProfiler.h
+ * @brief This file contains the GpuProfiler class and its methods.
+ *
+ * @details This file contains the GpuProfiler class which measures the cpu and gpu
+ * time of the stages of a frame, and the ProfileScope helper that times one stage.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include <GL/glew.h>
+
+/**
+ * @class GpuProfiler
+ * @brief Per stage cpu and gpu timer of the frames
+ *
+ * @details
+ * Every stage is timed twice: with the cpu clock between Begin and End, and with a
+ * GL_TIMESTAMP query at Begin and at End around the commands issued in between. A stage
+ * can run several times per frame, like the passes of several steps, its times are
+ * summed per frame. Stages nest: End stops the stage of the last Begin, and the time of
+ * a stage includes the stages inside it.
+ *
+ * The queries of a frame are read FRAME_LATENCY frames later, when the gpu has long
+ * finished them. A frame whose queries are still not available is dropped instead of
+ * waiting, so the profiler never stalls the pipeline.
+ *
+ * The last HISTORY frames are kept per stage for the p50 and p99 of the overlay, and the
+ * last MAX_TRACE_EVENTS stages for ExportChromeTrace.
+ */
+class GpuProfiler
+{
+public:
+	GpuProfiler();
+	~GpuProfiler();
+
+	void BeginFrame();
+	void Begin(const char* stage);
+	void End();
+
+	void OnImGuiRender();
+	bool ExportChromeTrace(const std::string& filepath) const;
+
+	float GetPercentile(const char* stage, bool gpu, float p) const;
+	unsigned int GetDroppedFrames() const { return m_DroppedFrames; }
+
+	static constexpr unsigned int FRAME_LATENCY = 3;
+	static constexpr unsigned int HISTORY = 240;
+	static constexpr size_t MAX_TRACE_EVENTS = 20000;
+
+private:
+	/// One Begin / End pair
+	struct Interval
+	{
+		unsigned int stage;
+		GLuint beginQuery;		///< timestamp at Begin
+		GLuint endQuery;		///< timestamp at End
+		double cpuBegin;		///< microseconds since the profiler was created
+		double cpuEnd;
+	};
+
+	/// The intervals of one frame, read FRAME_LATENCY frames later
+	struct Frame
+	{
+		std::vector<Interval> intervals;
+		std::vector<GLuint> queries;	///< pool, two per interval, grows to the most intervals of a frame
+		GLuint lastQuery = 0;			///< timestamp written last
+	};
+
+	/// Rolling times of one stage, in milliseconds per frame
+	struct Stage
+	{
+		std::string name;
+		std::vector<float> cpu;
+		std::vector<float> gpu;
+		unsigned int next = 0;			///< write position in cpu and gpu
+	};
+
+	/// Complete event of the Chrome trace format
+	struct TraceEvent
+	{
+		unsigned int stage;
+		bool gpu;
+		double begin;			///< microseconds
+		double duration;
+	};
+
+	unsigned int StageIndex(const char* stage);
+	void Resolve(Frame& frame);
+	double Now() const;
+
+	std::chrono::steady_clock::time_point m_Start;
+	Frame m_Frames[FRAME_LATENCY];
+	unsigned int m_FrameIndex;
+	std::vector<size_t> m_Open;		///< intervals of the current frame between Begin and End, innermost last
+	unsigned int m_DroppedFrames;
+
+	std::vector<Stage> m_Stages;
+	std::vector<TraceEvent> m_Trace;	///< ring of MAX_TRACE_EVENTS
+	size_t m_TraceNext;
+};
+
+/**
+ * @class ProfileScope
+ * @brief Times a stage from construction to destruction
+ *
+ * @details
+ * Does nothing when the profiler is nullptr, so profiled code does not need a profiler.
+ */
+class ProfileScope
+{
+public:
+	ProfileScope(GpuProfiler* profiler, const char* stage)
+		: m_Profiler(profiler) { if (m_Profiler) { m_Profiler->Begin(stage); } }
+	~ProfileScope() { if (m_Profiler) { m_Profiler->End(); } }
+
+	ProfileScope(const ProfileScope&) = delete;
+	ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+	GpuProfiler* m_Profiler;
+};
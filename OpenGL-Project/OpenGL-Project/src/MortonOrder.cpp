@@ -0,0 +1,134 @@
+/**
+ * @file MortonOrder.cpp
+ * @brief This file contains the implementation for the MortonOrder class.
+ *
+ * @details This file contains the method definitions for sorting the particles by the
+ * Morton code of their position in parallel.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "MortonOrder.h"
+
+#include <algorithm>
+
+#include "Particle.h"
+
+constexpr unsigned int MortonOrder::BITS;
+constexpr unsigned int MortonOrder::TOP_BITS;
+constexpr unsigned int MortonOrder::BUCKETS;
+
+MortonOrder::MortonOrder()
+{
+}
+
+MortonOrder::~MortonOrder()
+{
+}
+
+/**
+ * @brief Sort the particles by the Morton code of their position
+ *
+ * @param particles the dense particle array
+ * @param count number of particles
+ * @param boundsMin lower corner of the space the particles are in, usually the walls
+ * @param boundsMax upper corner
+ * @param threadPool threads to sort with
+ *
+ * @details
+ * Positions outside the bounds are clamped to the nearest cell of the cube.
+ */
+void MortonOrder::Sort(const Particle* particles, size_t count, const glm::vec3& boundsMin, const glm::vec3& boundsMax, ThreadPool& threadPool)
+{
+    m_Order.resize(count);
+    if (count == 0)
+    {
+        m_Keys.clear();
+        return;
+    }
+
+    ComputeKeys(count, [&](size_t i) { return ToVec3(particles[i].m_Position); }, boundsMin, CubeExtent(boundsMin, boundsMax), m_Unsorted, threadPool);
+    SortKeys(m_Unsorted, TOP_BITS, m_Keys, m_BucketStart, threadPool);
+
+    threadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        for (size_t k = begin; k < end; k++)
+            m_Order[k] = (uint32_t)m_Keys[k];
+    });
+}
+
+/**
+ * @brief Sort keys by their Morton code, then by their index
+ *
+ * @param unsorted keys of ComputeKeys
+ * @param topBits code bits of the buckets, at most SIM_DIM * BITS
+ * @param keys receives the sorted keys
+ * @param bucketStart receives the first key of every bucket, 2^topBits + 1 entries
+ * @param threadPool threads to sort with
+ *
+ * @details
+ * A counting sort on the top bits of the code splits the keys into buckets, the
+ * buckets are then sorted in parallel. The keys are unique, so the result is the
+ * same for every thread count.
+ */
+void MortonOrder::SortKeys(const std::vector<uint64_t>& unsorted, unsigned int topBits, std::vector<uint64_t>& keys, std::vector<unsigned int>& bucketStart, ThreadPool& threadPool)
+{
+    const unsigned int buckets = 1u << topBits;
+    const unsigned int bucketShift = 32 + SIM_DIM * BITS - topBits;
+    keys.resize(unsorted.size());
+    bucketStart.assign(buckets + 1, 0);
+    for (uint64_t key : unsorted)
+        bucketStart[(key >> bucketShift) + 1]++;
+    for (unsigned int b = 1; b <= buckets; b++)
+        bucketStart[b] += bucketStart[b - 1];
+
+    std::vector<unsigned int> insert(bucketStart.begin(), bucketStart.end() - 1);
+    for (uint64_t key : unsorted)
+        keys[insert[key >> bucketShift]++] = key;
+
+    threadPool.ParallelFor(buckets, [&](size_t first, size_t last)
+    {
+        for (size_t b = first; b < last; b++)
+            std::sort(keys.begin() + bucketStart[b], keys.begin() + bucketStart[b + 1]);
+    });
+}
+
+/**
+ * @brief Edge length of the cube over a bounding box
+ *
+ * @return float the largest extent of the SIM_DIM axes, 1 when the box is empty
+ */
+float MortonOrder::CubeExtent(const glm::vec3& boundsMin, const glm::vec3& boundsMax)
+{
+    float extent = 0.0f;
+    for (int axis = 0; axis < SIM_DIM; axis++)
+        extent = std::max(extent, boundsMax[axis] - boundsMin[axis]);
+    return extent > 0.0f ? extent : 1.0f;
+}
+
+/**
+ * @brief Morton code of a position in a cube
+ *
+ * @param pos the position, clamped to the nearest cell of the cube
+ * @param origin lower corner of the cube
+ * @param extent edge length of the cube
+ * @return uint32_t BITS bits per axis, interleaved with the x bit lowest
+ */
+uint32_t MortonOrder::Code(const glm::vec3& pos, const glm::vec3& origin, float extent)
+{
+    const float cells = (float)(1u << BITS);
+
+    uint32_t code = 0;
+    for (int axis = 0; axis < SIM_DIM; axis++)
+    {
+        float scaled = (pos[axis] - origin[axis]) / extent * cells;
+        uint32_t q = (uint32_t)glm::clamp(scaled, 0.0f, cells - 1.0f);
+        for (unsigned int bit = 0; bit < BITS; bit++)
+            code |= ((q >> bit) & 1u) << (bit * SIM_DIM + axis);
+    }
+    return code;
+}
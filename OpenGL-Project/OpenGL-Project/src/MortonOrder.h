@@ -0,0 +1,91 @@
+/**
+ * @file MortonOrder.h
+ * @brief This file contains the MortonOrder class and its methods.
+ *
+ * @details This file contains the MortonOrder class, which sorts the particles along
+ * the Z-order curve so particles that are close in space are close in memory.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "SimConfig.h"
+#include "ThreadPool.h"
+
+class Particle;
+
+/**
+ * @class MortonOrder
+ * @brief Dense index order of the particles along the Morton (Z-order) curve
+ *
+ * @details
+ * Sort computes the Morton code of every particle in the cube over the bounds, with
+ * BITS bits per axis, and sorts the particles by it. Particles with the same code keep
+ * their order, so the order is the same for every thread count.
+ *
+ * The codes are computed in parallel, a counting sort on the top bits splits the
+ * particles into BUCKETS and the buckets are sorted in parallel. BarnesHutTree sorts its
+ * bodies with the same static Code, ComputeKeys and SortKeys.
+ *
+ * GetOrder is the permutation for ParticleSystem::ApplyPermutation: the old dense index
+ * of every new dense index. The collision grid, the force passes and the renderer then
+ * read neighbouring particles from neighbouring memory.
+ */
+class MortonOrder
+{
+public:
+	MortonOrder();
+	~MortonOrder();
+
+	void Sort(const Particle* particles, size_t count, const glm::vec3& boundsMin, const glm::vec3& boundsMax, ThreadPool& threadPool);
+
+	const std::vector<unsigned int>& GetOrder() const { return m_Order; }
+
+	static uint32_t Code(const glm::vec3& pos, const glm::vec3& origin, float extent);
+	static float CubeExtent(const glm::vec3& boundsMin, const glm::vec3& boundsMax);
+
+	template<typename PositionOf>
+	static void ComputeKeys(size_t count, PositionOf positionOf, const glm::vec3& origin, float extent, std::vector<uint64_t>& keys, ThreadPool& threadPool);
+	static void SortKeys(const std::vector<uint64_t>& unsorted, unsigned int topBits, std::vector<uint64_t>& keys, std::vector<unsigned int>& bucketStart, ThreadPool& threadPool);
+
+	static constexpr unsigned int BITS = SIM_DIM == 2 ? 16 : 10;	///< Morton code bits per axis
+	static constexpr unsigned int TOP_BITS = SIM_DIM == 2 ? 8 : 9;	///< code bits of the buckets that are sorted in parallel
+	static constexpr unsigned int BUCKETS = 1u << TOP_BITS;
+
+private:
+	std::vector<uint64_t> m_Unsorted;			///< Morton code in the high and particle index in the low 32 bits
+	std::vector<uint64_t> m_Keys;				///< m_Unsorted sorted
+	std::vector<unsigned int> m_BucketStart;	///< first key of every bucket, BUCKETS + 1 entries
+	std::vector<unsigned int> m_Order;
+};
+
+/**
+ * @brief Compute the sort key of every position in parallel
+ *
+ * @param count number of positions
+ * @param positionOf returns the glm::vec3 position of an index
+ * @param origin lower corner of the cube
+ * @param extent edge length of the cube
+ * @param keys receives the Morton code in the high and the index in the low 32 bits
+ * @param threadPool threads to compute with
+ */
+template<typename PositionOf>
+void MortonOrder::ComputeKeys(size_t count, PositionOf positionOf, const glm::vec3& origin, float extent, std::vector<uint64_t>& keys, ThreadPool& threadPool)
+{
+	keys.resize(count);
+	threadPool.ParallelFor(count, [&](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			keys[i] = (uint64_t)Code(positionOf(i), origin, extent) << 32 | (uint64_t)i;
+	});
+}
@@ -19,23 +19,20 @@
  * 
  * @details
  * This constructor initializes a Particle object with default values.
+ * A 2D simulation drops the z of the position and velocity.
  */
 Particle::Particle
 (
     glm::vec3 pos = { 0.0f, 0.0f, 0.0f },
     glm::vec3 vel = { 0.0f, 0.0f, 0.0f },
-    glm::vec3 acc = { 0.0f, 0.0f, 0.0f },
     float m = 1.0f,
-    float r = 1.0f,
-    glm::vec4 color = { 1.0f, 1.0f, 1.0f, 1.0f },
-    unsigned int id = 0
+    float r = 1.0f
 )
-    : m_Position(pos), m_Velocity(vel), m_Acceleration(acc),
-    m_Mass(m), m_Radius(r),
-    m_PastPosition({ 0.0f, 0.0f, 0.0f }), m_PastVelocity({ 0.0f, 0.0f, 0.0f }), m_PastAcceleration({ 0.0f, 0.0f, 0.0f }),
-    m_ParticleID(id),
-    m_ParticleColor(color)
 {
+    m_Position = ToSimVec(pos);
+    m_Velocity = ToSimVec(vel);
+    m_Radius = r;
+    m_Mass = m;
 }
 
 /**
@@ -47,4 +44,34 @@ Particle::Particle
 Particle::~Particle()
 {
 
+}
+
+/**
+ * @brief Default constructor for the ParticleAttributes class.
+ * 
+ * @details
+ * This constructor initializes a ParticleAttributes object with default values,
+ * the past position, velocity and acceleration start at zero.
+ */
+ParticleAttributes::ParticleAttributes
+(
+    glm::vec3 acc = { 0.0f, 0.0f, 0.0f },
+    glm::vec4 color = { 1.0f, 1.0f, 1.0f, 1.0f },
+    unsigned int id = 0
+)
+    : m_ParticleColor(color),
+    m_Acceleration(acc), m_ParticleID(id),
+    m_PastPosition({ 0.0f, 0.0f, 0.0f }), m_PastVelocity({ 0.0f, 0.0f, 0.0f }), m_PastAcceleration({ 0.0f, 0.0f, 0.0f })
+{
+}
+
+/**
+ * @brief Destructor for the ParticleAttributes class.
+ * 
+ * @details
+ * This destructor destroys a ParticleAttributes object.
+ */
+ParticleAttributes::~ParticleAttributes()
+{
+
 }
\ No newline at end of file
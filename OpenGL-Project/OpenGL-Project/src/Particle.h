@@ -19,48 +19,86 @@
 
 #include "vendor/glm/glm.hpp" 
 
+#include "SimConfig.h"
+
 /**
  * @class Particle
  * @brief The Particle class for managing particles in the simulation.
  * 
  * @details
- * This class contains the properties of a particle, such as its position, velocity,
- * acceleration, mass, radius, color, and ID.
+ * This class contains the properties of a particle that every simulation step
+ * reads and writes: its position, velocity, radius and mass.
+ * The other properties are in a ParticleAttributes at the same index.
+ * The position and velocity have SIM_DIM components, 24 bytes in 2D and 32 bytes in 3D.
+ * The layout must match the Particle struct in Compute.glsl.
  */
 class Particle
 {
 public:
-	Particle(glm::vec3 pos, glm::vec3 vel, glm::vec3 acc, float m, float r, glm::vec4 color, unsigned int id);
+	Particle(glm::vec3 pos, glm::vec3 vel, float m, float r);
 	~Particle();
 
-	unsigned int getID() const { return m_ParticleID; }
+	friend class CpuSimulator;
+	friend class ParticleSoA;
+	friend class BarnesHutTree;
+	friend class ParticleMesh;
+	friend class MortonOrder;
 
 private:
-    unsigned int m_ParticleID; ///< Id of the particle (4 bytes)
-
+#if SIM_DIM == 2
+    SimVec m_Position;
+    SimVec m_Velocity;
+    float m_Radius;
+    float m_Mass;
+#else
+    SimVec m_Position;      
     float m_Radius;            
+
+    SimVec m_Velocity;      
     float m_Mass;              
-    float padding1 = 0.0f;//float padding1;            
+#endif
+};
 
-    glm::vec3 m_Position;      
-    float padding2 = 0.0f;//float padding2;            
+/**
+ * @class ParticleAttributes
+ * @brief The properties of a particle that are not needed every simulation step.
+ * 
+ * @details
+ * This class contains the color, acceleration, ID and the past position, velocity
+ * and acceleration of a particle, in 80 bytes. The past fields are written by the
+ * Verlet integrators, a new particle has none. They are stored in a buffer parallel
+ * to the Particle buffer, so the hot loop does not load them.
+ * The integration reads the acceleration every step, it stays here because it shares
+ * the first 32 bytes with the color: in the Particle it would add 8 or 16 bytes that
+ * the scatter, sort and collide passes load too.
+ * The layout must match the ParticleAttributes struct in Compute.glsl.
+ */
+class ParticleAttributes
+{
+public:
+	ParticleAttributes(glm::vec3 acc, glm::vec4 color, unsigned int id);
+	~ParticleAttributes();
+
+	unsigned int getID() const { return m_ParticleID; }
 
-    glm::vec3 m_Velocity;      
-    float padding3 = 0.0f;//float padding3;
+	friend class CpuSimulator;
+	friend class ParticleSoA;
+
+private:
+    glm::vec4 m_ParticleColor;
 
     glm::vec3 m_Acceleration;  
-    float padding4 = 0.0f;//float padding4;            
+    unsigned int m_ParticleID; ///< Id of the particle (4 bytes)
 
     glm::vec3 m_PastPosition;  
-    float padding5 = 0.0f;//float padding5;            
+    unsigned int m_HasPast = 0;	///< 1 when the past fields hold the last step of a Verlet integrator
 
     glm::vec3 m_PastVelocity;  
-    float padding6 = 0.0f;//float padding6;            
+    float padding2 = 0.0f;
 
     glm::vec3 m_PastAcceleration; 
-    float padding7 = 0.0f;// float padding7;               
-
-    glm::vec4 m_ParticleColor;
+    float padding3 = 0.0f;
 };
 
-
+static_assert(sizeof(Particle) == (SIM_DIM == 2 ? 24 : 32), "Particle must match the Particle struct in Compute.glsl");
+static_assert(sizeof(ParticleAttributes) == 80, "ParticleAttributes must match the ParticleAttributes struct in Compute.glsl");
@@ -0,0 +1,410 @@
+/**
+ * @file ParticleMesh.cpp
+ * @brief This file contains the implementation for the ParticleMesh class.
+ *
+ * @details This file contains the method definitions for depositing the particle
+ * masses, solving the potential with Fft convolutions and interpolating the
+ * gravitational acceleration. The MESH passes in Compute.glsl mirror them.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "ParticleMesh.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Particle.h"
+#include "ParticleSoA.h"
+
+constexpr unsigned int ParticleMesh::DEFAULT_CELLS;
+constexpr unsigned int ParticleMesh::MAX_CELLS;
+
+/// Corners of a cloud-in-cell stencil
+static constexpr unsigned int CORNERS = 1u << SIM_DIM;
+
+/// Offset of corner of a cloud-in-cell stencil, bit axis selects the upper cell
+static glm::ivec3 CornerOffset(unsigned int corner)
+{
+    glm::ivec3 offset(0);
+    for (int axis = 0; axis < SIM_DIM; axis++)
+        offset[axis] = (corner >> axis) & 1u;
+    return offset;
+}
+
+/// Cloud-in-cell weight of corner
+static float CornerWeight(unsigned int corner, const glm::vec3& fraction)
+{
+    float weight = 1.0f;
+    for (int axis = 0; axis < SIM_DIM; axis++)
+        weight *= ((corner >> axis) & 1u) ? fraction[axis] : 1.0f - fraction[axis];
+    return weight;
+}
+
+/// n^(SIM_DIM - 1), the rows of a grid of n cells per axis
+static size_t Rows(size_t n)
+{
+    return SIM_DIM == 2 ? n : n * n;
+}
+
+/**
+ * @brief Constructor
+ */
+ParticleMesh::ParticleMesh()
+    : m_Cells(0), m_Padded(0), m_Origin(0.0f), m_BoundsMax(0.0f), m_CellSize(1.0f), m_Softening(0.0f)
+{
+}
+
+/**
+ * @brief Destructor
+ */
+ParticleMesh::~ParticleMesh()
+{
+}
+
+/**
+ * @brief Set the grid and compute the spectrum of the Green's function
+ *
+ * @param boundsMin lower corner of the grid, the lower walls
+ * @param boundsMax upper walls
+ * @param cells cells per axis, a power of two of at least 2
+ * @param softening softening length of the gravity
+ * @param threadPool threads to transform with
+ *
+ * @return true if the spectrum was computed again, false if nothing changed
+ */
+bool ParticleMesh::Configure(const glm::vec3& boundsMin, const glm::vec3& boundsMax, unsigned int cells, float softening, ThreadPool& threadPool)
+{
+    cells = std::max(cells, 2u);
+
+    float cellSize = 0.0f;
+    for (int axis = 0; axis < SIM_DIM; axis++)
+        cellSize = std::max(cellSize, (boundsMax[axis] - boundsMin[axis]) / cells);
+    if (cellSize <= 0.0f)
+        cellSize = 1.0f;
+    softening = std::max(softening, 0.5f * cellSize);
+
+    if (cells == m_Cells && boundsMin == m_Origin && boundsMax == m_BoundsMax && softening == m_Softening)
+        return false;
+
+    m_Cells = cells;
+    m_Padded = 2 * cells;
+    m_Origin = boundsMin;
+    m_BoundsMax = boundsMax;
+    m_CellSize = cellSize;
+    m_Softening = softening;
+
+    m_RowFft.Resize(m_Cells);
+    m_ColumnFft.Resize(m_Padded);
+
+    size_t gridCells = Rows(m_Cells) * m_Cells;
+    m_Density.assign(gridCells, 0.0f);
+    m_Potential.assign(gridCells, 0.0f);
+    m_Spectrum.assign(Rows(m_Padded) * (m_Cells + 1), std::complex<float>(0.0f));
+
+    // the Green's function on the padded grid, distances past the middle wrap around
+    const size_t padded = m_Padded;
+    std::vector<float> green(Rows(padded) * padded);
+    threadPool.ParallelFor(green.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+        {
+            size_t cell[3] = { i % padded, (i / padded) % padded, i / (padded * padded) };
+            float r2 = softening * softening;
+            for (int axis = 0; axis < SIM_DIM; axis++)
+            {
+                float d = cellSize * std::min(cell[axis], padded - cell[axis]);
+                r2 += d * d;
+            }
+            green[i] = -1.0f / std::sqrt(r2);
+        }
+    });
+
+    ForwardRows(green.data(), m_Padded, threadPool);
+    for (unsigned int axis = 1; axis < SIM_DIM; axis++)
+        TransformColumns(axis, false, threadPool);
+
+    // the Green's function is real and even, so is its spectrum
+    m_Green.resize(m_Spectrum.size());
+    for (size_t i = 0; i < m_Spectrum.size(); i++)
+        m_Green[i] = m_Spectrum[i].real();
+
+    return true;
+}
+
+/**
+ * @brief Solve the potential of the masses of the particles
+ *
+ * @param particles the particles
+ * @param count number of particles
+ * @param threadPool threads to solve with
+ */
+void ParticleMesh::Solve(const Particle* particles, size_t count, ThreadPool& threadPool)
+{
+    m_Bodies.resize(count);
+    threadPool.ParallelFor(count, [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            m_Bodies[i] = glm::vec4(ToVec3(particles[i].m_Position), particles[i].m_Mass);
+    });
+
+    Solve(threadPool);
+}
+
+/**
+ * @brief Solve the potential of the masses of structure of arrays particles
+ *
+ * @param particles the particles
+ * @param threadPool threads to solve with
+ */
+void ParticleMesh::Solve(const ParticleSoA& particles, ThreadPool& threadPool)
+{
+    m_Bodies.resize(particles.size());
+    threadPool.ParallelFor(particles.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            m_Bodies[i] = glm::vec4(ToVec3(particles.GetPosition(i)), particles.Mass()[i]);
+    });
+
+    Solve(threadPool);
+}
+
+/**
+ * @brief Solve the potential of m_Bodies
+ *
+ * @param threadPool threads to solve with
+ *
+ * @details
+ * The density is transformed along every axis, multiplied by the spectrum of the
+ * Green's function and transformed back along every axis in the reverse order.
+ */
+void ParticleMesh::Solve(ThreadPool& threadPool)
+{
+    if (m_Cells == 0)
+        return;
+
+    Deposit(threadPool);
+
+    ForwardRows(m_Density.data(), m_Cells, threadPool);
+    for (unsigned int axis = 1; axis < SIM_DIM; axis++)
+        TransformColumns(axis, false, threadPool);
+
+    threadPool.ParallelFor(m_Spectrum.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t i = begin; i < end; i++)
+            m_Spectrum[i] *= m_Green[i];
+    });
+
+    for (unsigned int axis = SIM_DIM - 1; axis >= 1; axis--)
+        TransformColumns(axis, true, threadPool);
+    InverseRows(threadPool);
+}
+
+/**
+ * @brief Deposit the masses of m_Bodies on m_Density
+ *
+ * @param threadPool threads to deposit with
+ *
+ * @details
+ * Every thread deposits a contiguous range of the bodies on its own grid, the grids
+ * are summed per cell afterwards.
+ */
+void ParticleMesh::Deposit(ThreadPool& threadPool)
+{
+    size_t count = m_Bodies.size();
+    size_t threads = threadPool.GetThreadCount();
+    m_Partial.resize(threads);
+
+    threadPool.ParallelFor(threads, [&](size_t begin, size_t end)
+    {
+        for (size_t thread = begin; thread < end; thread++)
+        {
+            std::vector<float>& grid = m_Partial[thread];
+            grid.assign(m_Density.size(), 0.0f);
+
+            for (size_t i = count * thread / threads; i < count * (thread + 1) / threads; i++)
+            {
+                glm::ivec3 first;
+                glm::vec3 fraction;
+                CloudInCell(glm::vec3(m_Bodies[i]), first, fraction);
+                for (unsigned int corner = 0; corner < CORNERS; corner++)
+                    grid[CellIndex(first + CornerOffset(corner))] += m_Bodies[i].w * CornerWeight(corner, fraction);
+            }
+        }
+    });
+
+    threadPool.ParallelFor(m_Density.size(), [&](size_t begin, size_t end)
+    {
+        for (size_t cell = begin; cell < end; cell++)
+        {
+            float mass = 0.0f;
+            for (size_t thread = 0; thread < threads; thread++)
+                mass += m_Partial[thread][cell];
+            m_Density[cell] = mass;
+        }
+    });
+}
+
+/**
+ * @brief Transform the rows of a real grid along x into m_Spectrum
+ *
+ * @param real the grid, x fastest
+ * @param realCells cells per axis of the grid, the rest of the padded grid is zero
+ * @param threadPool threads to transform with
+ */
+void ParticleMesh::ForwardRows(const float* real, unsigned int realCells, ThreadPool& threadPool)
+{
+    const size_t frequencies = m_Cells + 1;
+    threadPool.ParallelFor(Rows(m_Padded), [&](size_t begin, size_t end)
+    {
+        std::vector<float> row(m_Padded);
+        for (size_t r = begin; r < end; r++)
+        {
+            size_t y = r % m_Padded;
+            size_t z = r / m_Padded;
+            std::complex<float>* output = &m_Spectrum[r * frequencies];
+            if (y >= realCells || z >= realCells)
+            {
+                std::fill(output, output + frequencies, std::complex<float>(0.0f));
+                continue;
+            }
+
+            const float* input = real + (z * realCells + y) * realCells;
+            std::copy(input, input + realCells, row.begin());
+            std::fill(row.begin() + realCells, row.end(), 0.0f);
+            m_RowFft.RealForward(row.data(), output);
+        }
+    });
+}
+
+/**
+ * @brief Transform m_Spectrum along y (axis 1) or z (axis 2)
+ *
+ * @param axis the axis
+ * @param inverse the inverse transform
+ * @param threadPool threads to transform with
+ */
+void ParticleMesh::TransformColumns(unsigned int axis, bool inverse, ThreadPool& threadPool)
+{
+    size_t stride = m_Cells + 1;
+    for (unsigned int a = 1; a < axis; a++)
+        stride *= m_Padded;
+
+    threadPool.ParallelFor(m_Spectrum.size() / m_Padded, [&](size_t begin, size_t end)
+    {
+        std::vector<std::complex<float>> column(m_Padded);
+        for (size_t c = begin; c < end; c++)
+        {
+            size_t base = (c / stride) * stride * m_Padded + c % stride;
+            for (size_t k = 0; k < m_Padded; k++)
+                column[k] = m_Spectrum[base + k * stride];
+            m_ColumnFft.Transform(column.data(), inverse);
+            for (size_t k = 0; k < m_Padded; k++)
+                m_Spectrum[base + k * stride] = column[k];
+        }
+    });
+}
+
+/**
+ * @brief Transform the rows of m_Spectrum back along x into m_Potential
+ *
+ * @param threadPool threads to transform with
+ *
+ * @details
+ * Only the rows and cells of the unpadded grid are kept.
+ */
+void ParticleMesh::InverseRows(ThreadPool& threadPool)
+{
+    const size_t frequencies = m_Cells + 1;
+    threadPool.ParallelFor(Rows(m_Cells), [&](size_t begin, size_t end)
+    {
+        std::vector<std::complex<float>> spectrum(frequencies);
+        std::vector<float> row(m_Padded);
+        for (size_t r = begin; r < end; r++)
+        {
+            size_t y = r % m_Cells;
+            size_t z = r / m_Cells;
+            const std::complex<float>* input = &m_Spectrum[(z * m_Padded + y) * frequencies];
+            std::copy(input, input + frequencies, spectrum.begin());
+            m_RowFft.RealInverse(spectrum.data(), row.data());
+            std::copy(row.begin(), row.begin() + m_Cells, m_Potential.begin() + r * m_Cells);
+        }
+    });
+}
+
+/**
+ * @brief Gravitational acceleration at a position
+ *
+ * @param pos the position
+ * @param gravityConstant G
+ *
+ * @return -G times the gradient of the potential, interpolated from the cells
+ */
+glm::vec3 ParticleMesh::Acceleration(const glm::vec3& pos, float gravityConstant) const
+{
+    if (m_Cells == 0)
+        return glm::vec3(0.0f);
+
+    glm::ivec3 first;
+    glm::vec3 fraction;
+    CloudInCell(pos, first, fraction);
+
+    glm::vec3 gradient(0.0f);
+    for (unsigned int corner = 0; corner < CORNERS; corner++)
+        gradient += CornerWeight(corner, fraction) * Gradient(first + CornerOffset(corner));
+    return -gravityConstant * gradient;
+}
+
+/**
+ * @brief Cloud-in-cell stencil of a position
+ *
+ * @param pos the position
+ * @param first lower cell of the stencil
+ * @param fraction weight of the upper cells per axis
+ *
+ * @details
+ * Positions outside the grid are clamped to the centers of the outer cells.
+ */
+void ParticleMesh::CloudInCell(const glm::vec3& pos, glm::ivec3& first, glm::vec3& fraction) const
+{
+    first = glm::ivec3(0);
+    fraction = glm::vec3(0.0f);
+    for (int axis = 0; axis < SIM_DIM; axis++)
+    {
+        float u = (pos[axis] - m_Origin[axis]) / m_CellSize - 0.5f;
+        u = std::min(std::max(u, 0.0f), (float)(m_Cells - 1));
+        first[axis] = std::min((int)std::floor(u), (int)m_Cells - 2);
+        fraction[axis] = u - first[axis];
+    }
+}
+
+/**
+ * @brief Gradient of the potential in a cell, central differences clamped at the edges
+ *
+ * @param cell the cell
+ */
+glm::vec3 ParticleMesh::Gradient(const glm::ivec3& cell) const
+{
+    glm::vec3 gradient(0.0f);
+    for (int axis = 0; axis < SIM_DIM; axis++)
+    {
+        glm::ivec3 lo = cell;
+        glm::ivec3 hi = cell;
+        lo[axis] = std::max(cell[axis] - 1, 0);
+        hi[axis] = std::min(cell[axis] + 1, (int)m_Cells - 1);
+        gradient[axis] = (m_Potential[CellIndex(hi)] - m_Potential[CellIndex(lo)]) / ((hi[axis] - lo[axis]) * m_CellSize);
+    }
+    return gradient;
+}
+
+/**
+ * @brief Index of a cell of the unpadded grid, x fastest
+ */
+size_t ParticleMesh::CellIndex(const glm::ivec3& cell) const
+{
+    return ((size_t)cell.z * m_Cells + cell.y) * m_Cells + cell.x;
+}
@@ -0,0 +1,104 @@
+/**
+ * @file ParticleMesh.h
+ * @brief This file contains the ParticleMesh class and its methods.
+ *
+ * @details This file contains the ParticleMesh class, the particle-mesh solver of
+ * the mutual gravity of ForceMode::ParticleMesh.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include <complex>
+#include <vector>
+
+#include "glm/glm.hpp"
+
+#include "Fft.h"
+#include "SimConfig.h"
+#include "ThreadPool.h"
+
+class Particle;
+class ParticleSoA;
+
+/**
+ * @class ParticleMesh
+ * @brief Particle-mesh gravity on a grid of GetCells() cells per axis
+ *
+ * @details
+ * Solve deposits the particle masses on the grid with cloud-in-cell weights and
+ * convolves them with the Green's function -1 / sqrt(r^2 + s^2) of a point mass,
+ * which solves the Poisson equation of the potential. The convolution is a product of
+ * the spectra: the grid is zero padded to 2 * GetCells() per axis, so the masses do not
+ * feel periodic images, and transformed with a real-to-complex Fft along x and complex
+ * Ffts along the other axes. Acceleration differentiates the potential with central
+ * differences and interpolates the gradient with the same cloud-in-cell weights, so a
+ * particle does not pull itself.
+ *
+ * The grid covers the walls of the simulation with cubic cells. The softening s is at
+ * least half a cell, the grid does not resolve closer encounters. Solve costs
+ * O(N + G log G) for N particles and G cells.
+ *
+ * The Green's function spectrum only changes with the grid and the softening, Configure
+ * computes it. ComputeShader uploads it and runs the same steps in Compute.glsl.
+ *
+ * The spectrum is stored x fastest, with GetCells() + 1 frequencies along x and
+ * 2 * GetCells() along the other axes.
+ */
+class ParticleMesh
+{
+public:
+	ParticleMesh();
+	~ParticleMesh();
+
+	bool Configure(const glm::vec3& boundsMin, const glm::vec3& boundsMax, unsigned int cells, float softening, ThreadPool& threadPool);
+
+	void Solve(const Particle* particles, size_t count, ThreadPool& threadPool);
+	void Solve(const ParticleSoA& particles, ThreadPool& threadPool);
+
+	glm::vec3 Acceleration(const glm::vec3& pos, float gravityConstant) const;
+
+	const std::vector<glm::vec4>& GetBodies() const { return m_Bodies; }	///< position and mass per particle
+	const std::vector<float>& GetGreenSpectrum() const { return m_Green; }
+	const std::vector<float>& GetPotential() const { return m_Potential; }
+
+	unsigned int GetCells() const { return m_Cells; }
+	float GetCellSize() const { return m_CellSize; }
+	size_t GetSpectrumSize() const { return m_Spectrum.size(); }
+
+	static constexpr unsigned int DEFAULT_CELLS = SIM_DIM == 2 ? 256 : 64;
+	static constexpr unsigned int MAX_CELLS = SIM_DIM == 2 ? 1024 : 128;	///< the padded spectrum is 16 MB in 2D and 67 MB in 3D at this size
+
+private:
+	void Solve(ThreadPool& threadPool);
+	void Deposit(ThreadPool& threadPool);
+	void ForwardRows(const float* real, unsigned int realCells, ThreadPool& threadPool);
+	void TransformColumns(unsigned int axis, bool inverse, ThreadPool& threadPool);
+	void InverseRows(ThreadPool& threadPool);
+
+	void CloudInCell(const glm::vec3& pos, glm::ivec3& first, glm::vec3& fraction) const;
+	glm::vec3 Gradient(const glm::ivec3& cell) const;
+	size_t CellIndex(const glm::ivec3& cell) const;
+
+	unsigned int m_Cells;			///< cells per axis, a power of two
+	unsigned int m_Padded;			///< 2 * m_Cells, the transform size per axis
+	glm::vec3 m_Origin;				///< lower corner of the grid
+	glm::vec3 m_BoundsMax;
+	float m_CellSize;
+	float m_Softening;				///< softening the spectrum was computed with
+
+	Fft m_RowFft;					///< half size complex transform of the real rows
+	Fft m_ColumnFft;
+
+	std::vector<glm::vec4> m_Bodies;
+	std::vector<std::vector<float>> m_Partial;		///< deposit of every thread
+	std::vector<float> m_Density;					///< mass per cell
+	std::vector<std::complex<float>> m_Spectrum;
+	std::vector<float> m_Green;						///< real spectrum of the Green's function
+	std::vector<float> m_Potential;					///< potential per cell, without G
+};
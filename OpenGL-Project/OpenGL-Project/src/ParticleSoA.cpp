@@ -0,0 +1,173 @@
+/**
+ * @file ParticleSoA.cpp
+ * @brief This file contains the implementation for the ParticleSoA class.
+ *
+ * @details This file contains the method definitions for converting between the
+ * array of structures in a ParticleSystem and the structure of arrays storage.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "ParticleSoA.h"
+
+/**
+ * @brief Constructor
+ */
+ParticleSoA::ParticleSoA()
+{
+}
+
+/**
+ * @brief Destructor
+ */
+ParticleSoA::~ParticleSoA()
+{
+}
+
+/**
+ * @brief Resize all arrays
+ *
+ * @param count number of particles
+ */
+void ParticleSoA::resize(size_t count)
+{
+    for (int axis = 0; axis < SIM_DIM; axis++)
+    {
+        m_Position[axis].resize(count);
+        m_Velocity[axis].resize(count);
+        m_Acceleration[axis].resize(count);
+        m_PastPosition[axis].resize(count);
+        m_PastAcceleration[axis].resize(count);
+    }
+    m_HasPast.resize(count);
+    m_Radius.resize(count);
+    m_Mass.resize(count);
+    m_Color.resize(count);
+    m_ID.resize(count);
+}
+
+/**
+ * @brief Copy the particles of a particlesystem into the arrays
+ *
+ * @param particlesystem the particles to copy
+ *
+ * @details
+ * The particles keep their index, the arrays are resized to the particle count.
+ */
+void ParticleSoA::Gather(const ParticleSystem& particlesystem)
+{
+    size_t count = particlesystem.size();
+    const Particle* particles = particlesystem.data();
+    const ParticleAttributes* attributes = particlesystem.attributes();
+    resize(count);
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int axis = 0; axis < SIM_DIM; axis++)
+        {
+            m_Position[axis][i] = particles[i].m_Position[axis];
+            m_Velocity[axis][i] = particles[i].m_Velocity[axis];
+            m_Acceleration[axis][i] = attributes[i].m_Acceleration[axis];
+            m_PastPosition[axis][i] = attributes[i].m_PastPosition[axis];
+            m_PastAcceleration[axis][i] = attributes[i].m_PastAcceleration[axis];
+        }
+        m_HasPast[i] = attributes[i].m_HasPast;
+        m_Radius[i] = particles[i].m_Radius;
+        m_Mass[i] = particles[i].m_Mass;
+        m_Color[i] = attributes[i].m_ParticleColor;
+        m_ID[i] = attributes[i].m_ParticleID;
+    }
+}
+
+/**
+ * @brief Copy the arrays back into the particles of a particlesystem
+ *
+ * @param particlesystem the particlesystem the arrays were gathered from
+ *
+ * @details
+ * Only the properties stored in the arrays are written, the particlesystem
+ * must still hold the same particles in the same order.
+ */
+void ParticleSoA::Scatter(ParticleSystem& particlesystem) const
+{
+    size_t count = particlesystem.size() < size() ? particlesystem.size() : size();
+    Particle* particles = particlesystem.data();
+    ParticleAttributes* attributes = particlesystem.attributes();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        for (int axis = 0; axis < SIM_DIM; axis++)
+        {
+            particles[i].m_Position[axis] = m_Position[axis][i];
+            particles[i].m_Velocity[axis] = m_Velocity[axis][i];
+            attributes[i].m_Acceleration[axis] = m_Acceleration[axis][i];
+            attributes[i].m_PastPosition[axis] = m_PastPosition[axis][i];
+            attributes[i].m_PastAcceleration[axis] = m_PastAcceleration[axis][i];
+        }
+        attributes[i].m_HasPast = m_HasPast[i];
+        particles[i].m_Radius = m_Radius[i];
+        particles[i].m_Mass = m_Mass[i];
+        attributes[i].m_ParticleColor = m_Color[i];
+    }
+}
+
+/**
+ * @brief Build the arrays of particles and attributes from the arrays
+ *
+ * @param particles output, resized to the particle count
+ * @param attributes output, resized to the particle count
+ *
+ * @details
+ * Used to upload a ParticleSoA to buffers with the Particle and ParticleAttributes layout.
+ */
+void ParticleSoA::Scatter(std::vector<Particle>& particles, std::vector<ParticleAttributes>& attributes) const
+{
+    particles.clear();
+    particles.reserve(size());
+    attributes.clear();
+    attributes.reserve(size());
+
+    for (size_t i = 0; i < size(); i++)
+    {
+        glm::vec3 acc(0.0f);
+        for (int axis = 0; axis < SIM_DIM; axis++) { acc[axis] = m_Acceleration[axis][i]; }
+        particles.emplace_back(ToVec3(GetPosition(i)), ToVec3(GetVelocity(i)), m_Mass[i], m_Radius[i]);
+        attributes.emplace_back(acc, m_Color[i], m_ID[i]);
+        for (int axis = 0; axis < SIM_DIM; axis++)
+        {
+            attributes.back().m_PastPosition[axis] = m_PastPosition[axis][i];
+            attributes.back().m_PastAcceleration[axis] = m_PastAcceleration[axis][i];
+        }
+        attributes.back().m_HasPast = m_HasPast[i];
+    }
+}
+
+/**
+ * @brief Get the position of a particle
+ *
+ * @param i index of the particle
+ * @return SimVec the position gathered from the arrays of every axis
+ */
+SimVec ParticleSoA::GetPosition(size_t i) const
+{
+    SimVec pos;
+    for (int axis = 0; axis < SIM_DIM; axis++) { pos[axis] = m_Position[axis][i]; }
+    return pos;
+}
+
+/**
+ * @brief Get the velocity of a particle
+ *
+ * @param i index of the particle
+ * @return SimVec the velocity gathered from the arrays of every axis
+ */
+SimVec ParticleSoA::GetVelocity(size_t i) const
+{
+    SimVec vel;
+    for (int axis = 0; axis < SIM_DIM; axis++) { vel[axis] = m_Velocity[axis][i]; }
+    return vel;
+}
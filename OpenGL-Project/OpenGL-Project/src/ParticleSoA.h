@@ -0,0 +1,123 @@
+/**
+ * @file ParticleSoA.h
+ * @brief This file contains the ParticleSoA class and its methods.
+ *
+ * @details This file contains the structure of arrays storage for the particles.
+ * Every property is stored in its own aligned array, so a loop that only touches
+ * positions and velocities does not load the rest of the particle.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include <vector>
+#include <new>
+#include <cstdint>
+
+#include "glm/glm.hpp"
+
+#include "Particlesystem.h"
+
+/**
+ * @class AlignedAllocator
+ * @brief Allocator for std::vector that aligns the data to Alignment bytes
+ *
+ * @details
+ * The arrays of ParticleSoA are aligned to a cache line, which is also the
+ * width of an AVX-512 register.
+ */
+template<typename T, size_t Alignment>
+class AlignedAllocator
+{
+public:
+	using value_type = T;
+
+	template<typename U>
+	struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+	AlignedAllocator() {}
+	template<typename U>
+	AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t count)
+	{
+		// store the unaligned pointer in front of the aligned block
+		void* raw = ::operator new(count * sizeof(T) + Alignment + sizeof(void*));
+		uintptr_t aligned = ((uintptr_t)raw + sizeof(void*) + Alignment - 1) & ~(uintptr_t)(Alignment - 1);
+		((void**)aligned)[-1] = raw;
+		return (T*)aligned;
+	}
+
+	void deallocate(T* ptr, size_t)
+	{
+		::operator delete(((void**)ptr)[-1]);
+	}
+
+	template<typename U>
+	bool operator==(const AlignedAllocator<U, Alignment>&) const { return true; }
+	template<typename U>
+	bool operator!=(const AlignedAllocator<U, Alignment>&) const { return false; }
+};
+
+template<typename T>
+using AlignedVector = std::vector<T, AlignedAllocator<T, 64>>;
+
+/**
+ * @class ParticleSoA
+ * @brief Structure of arrays copy of a ParticleSystem
+ *
+ * @details
+ * Holds the particles with one aligned array per property: position, velocity and
+ * acceleration per axis, radius, mass, color and id. There are SIM_DIM axes. The past position
+ * and acceleration per axis and the past flag of the Verlet integrators are kept as well,
+ * so every Integrator gives the same bits as the ParticleSystem. Gather and Scatter convert
+ * from and to the array of structures in a ParticleSystem, UploadData of the
+ * ComputeShader accepts a ParticleSoA through the same conversion.
+ */
+class ParticleSoA
+{
+public:
+	ParticleSoA();
+	~ParticleSoA();
+
+	size_t size() const { return m_Radius.size(); }
+	void resize(size_t count);
+
+	void Gather(const ParticleSystem& particlesystem);
+	void Scatter(ParticleSystem& particlesystem) const;
+	void Scatter(std::vector<Particle>& particles, std::vector<ParticleAttributes>& attributes) const;
+
+	float* Position(int axis) { return m_Position[axis].data(); }
+	float* Velocity(int axis) { return m_Velocity[axis].data(); }
+	float* Acceleration(int axis) { return m_Acceleration[axis].data(); }
+	float* Radius() { return m_Radius.data(); }
+	float* Mass() { return m_Mass.data(); }
+	float* PastPosition(int axis) { return m_PastPosition[axis].data(); }
+	float* PastAcceleration(int axis) { return m_PastAcceleration[axis].data(); }
+	unsigned int* HasPast() { return m_HasPast.data(); }
+	const float* Position(int axis) const { return m_Position[axis].data(); }
+	const float* Velocity(int axis) const { return m_Velocity[axis].data(); }
+	const float* Acceleration(int axis) const { return m_Acceleration[axis].data(); }
+	const float* Radius() const { return m_Radius.data(); }
+	const float* Mass() const { return m_Mass.data(); }
+
+	SimVec GetPosition(size_t i) const;
+	SimVec GetVelocity(size_t i) const;
+
+private:
+	AlignedVector<float> m_Position[SIM_DIM];
+	AlignedVector<float> m_Velocity[SIM_DIM];
+	AlignedVector<float> m_Acceleration[SIM_DIM];
+	AlignedVector<float> m_PastPosition[SIM_DIM];		///< position of the last step of Integrator::PositionVerlet
+	AlignedVector<float> m_PastAcceleration[SIM_DIM];	///< acceleration of the last step of Integrator::VelocityVerlet
+	AlignedVector<unsigned int> m_HasPast;				///< 1 when the past fields hold the last step
+	AlignedVector<float> m_Radius;
+	AlignedVector<float> m_Mass;
+	AlignedVector<glm::vec4> m_Color;
+	AlignedVector<unsigned int> m_ID;
+};
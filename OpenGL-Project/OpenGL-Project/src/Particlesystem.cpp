@@ -14,8 +14,7 @@
 
 #include "Particlesystem.h"
 
-#include "Shader.h"
-#include "Renderer.h"
+const unsigned int ParticleSystem::INVALID_INDEX;
 
  /**
   * @brief Constructs a ParticleSystem instance with an initial particle count of zero.
@@ -39,6 +38,70 @@ ParticleSystem::~ParticleSystem()
 {
 }
 
+/**
+ * @brief Fill the freelist with every id
+ * 
+ * @details
+ * Push the ids in reverse so the lowest id is handed out first, mark every id
+ * as free in the sparse table and reserve the dense arrays for all particles.
+ */
+void ParticleSystem::InitFreelist()
+{
+    for (int i = m_MaxParticles - 1; i >= 0; --i) { m_Freelist.push(i); }
+
+    m_Sparse.assign(m_MaxParticles, INVALID_INDEX);
+    m_Particles.reserve(m_MaxParticles);
+    m_Attributes.reserve(m_MaxParticles);
+    m_IDlist.reserve(m_MaxParticles);
+}
+
+/**
+ * @brief Set the maximum number of particles
+ * 
+ * @param size the new maximum
+ * 
+ * @details
+ * Before InitFreelist this only sets the maximum. After it the capacity is
+ * grown with Grow, the capacity can not shrink.
+ */
+void ParticleSystem::MemorySize(unsigned int size)
+{
+    if (m_Sparse.empty())
+        m_MaxParticles = size;
+    else
+        Grow(size);
+}
+
+/**
+ * @brief Grow the maximum number of particles
+ * 
+ * @param capacity the new maximum, must be larger than the current one
+ * @return true when the capacity was grown
+ * 
+ * @details
+ * The new ids are pushed onto the freelist, lowest id on top, and marked free
+ * in the sparse table. The live particles keep their id and dense index, only
+ * the address of the dense array can change. The gpu buffers follow with
+ * ComputeShader::Reserve.
+ */
+bool ParticleSystem::Grow(unsigned int capacity)
+{
+    if (capacity <= m_MaxParticles)
+    {
+        std::cerr << "Can not shrink the particle system from " << m_MaxParticles << " to " << capacity << " particles!" << std::endl;
+        return false;
+    }
+
+    for (size_t i = capacity; i-- > m_MaxParticles; ) { m_Freelist.push(i); }
+
+    m_MaxParticles = capacity;
+    m_Sparse.resize(m_MaxParticles, INVALID_INDEX);
+    m_Particles.reserve(m_MaxParticles);
+    m_Attributes.reserve(m_MaxParticles);
+    m_IDlist.reserve(m_MaxParticles);
+    return true;
+}
+
 /**
  * @brief Creates a new particle with specified properties and adds it to the particle system.
  *
@@ -53,6 +116,7 @@ ParticleSystem::~ParticleSystem()
  * This function creates a new particle with the specified properties and adds it to the particle system.
  * The particle is assigned a unique identifier and added to the list of particles. The particle count is
  * updated and the unique identifier is returned.
+ * When every id is in use and auto growth is on, the capacity is doubled first.
  */
 size_t ParticleSystem::CreateParticle(
     glm::vec3 pos = { 0.0f, 0.0f, 0.0f },
@@ -61,13 +125,23 @@ size_t ParticleSystem::CreateParticle(
     float m = 1.0, float r = 1.0,
     glm::vec4 color = { 1.0f, 0.0f, 0.0f, 1.0f })
 {
+    if (m_Freelist.empty() && m_AutoGrow && !m_Sparse.empty())
+    {
+        size_t capacity = m_MaxParticles * GROWTH_FACTOR;
+        if (capacity > INVALID_INDEX) { capacity = INVALID_INDEX; }   ///< INVALID_INDEX is never an id
+        if (capacity > m_MaxParticles) { Grow((unsigned int)capacity); }
+    }
+
     if (!m_Freelist.empty())
     {
         size_t freeIndex = m_Freelist.top();
         m_Freelist.pop();
-        m_Particles.emplace_back(pos, vel, acc, m, r, color, freeIndex);
+        m_Sparse[freeIndex] = (unsigned int)m_Particles.size();
+        m_Particles.emplace_back(pos, vel, m, r);
+        m_Attributes.emplace_back(acc, color, (unsigned int)freeIndex);
         m_IDlist.push_back(freeIndex);
         m_ParticleCount = GetParticleCount();
+        MarkDirty(m_Sparse[freeIndex]);
         return freeIndex;
     }
     else
@@ -84,24 +158,111 @@ size_t ParticleSystem::CreateParticle(
  * @note This function ensures the specified particle is deleted and removed from the system.
  * 
  * @details
- * This function destroys a particle by its unique identifier. The particle is removed from the list of particles
- * and the unique identifier is added back to the freelist. The particle count is updated and the unique identifier
- * is removed from the list of identifiers.
+ * This function destroys a particle by its unique identifier. The last particle is moved into
+ * the slot of the destroyed particle and the unique identifier is added back to the freelist.
+ * This changes the index of the moved particle, the ids stay the same.
  */
-void ParticleSystem::DestroyParticle(unsigned int id)       ///< werkt niet als computeshader wordt gecalled.
+void ParticleSystem::DestroyParticle(unsigned int id)
 {
-    m_Freelist.push(id);
+    if (!IsAlive(id))
+    {
+        std::cerr << "Particle " << id << " does not exist!" << std::endl;
+        return;
+    }
 
-    m_Particles.erase
-    (
-        std::remove_if(m_Particles.begin(), m_Particles.end(),
-            [id](const Particle& p) { return p.getID() == id; }),
-        m_Particles.end()
-    );
+    unsigned int index = m_Sparse[id];
+    unsigned int last = (unsigned int)m_Particles.size() - 1;
+
+    if (index != last)
+    {
+        m_Particles[index] = m_Particles[last];
+        m_Attributes[index] = m_Attributes[last];
+        m_IDlist[index] = m_IDlist[last];
+        m_Sparse[m_IDlist[index]] = index;
+
+        if (m_GpuResident && !IsDirty(last))
+        {
+            m_Moves.emplace_back(last, index);
+            UnmarkDirty(index);
+        }
+        else
+        {
+            MarkDirty(index);
+        }
+    }
+
+    if (last < m_DirtyFlags.size())
+        m_DirtyFlags[last] = 0;
+
+    m_Particles.pop_back();
+    m_Attributes.pop_back();
+    m_IDlist.pop_back();
+    m_Sparse[id] = INVALID_INDEX;
+    m_Freelist.push(id);
+    m_LayoutVersion++;
 
-    m_Particles.shrink_to_fit();
     m_ParticleCount = GetParticleCount();
-    m_IDlist.erase(std::remove(m_IDlist.begin(), m_IDlist.end(), id), m_IDlist.end());
+}
+
+/**
+ * @brief Destroys a batch of particles by their unique identifiers.
+ *
+ * @param ids The identifiers of the particles to destroy.
+ * @param count The number of identifiers.
+ * 
+ * @details
+ * Every particle is removed in O(1), so the batch costs O(count) independent
+ * of the number of particles in the system. Ids that do not exist are skipped.
+ */
+void ParticleSystem::DestroyParticles(const unsigned int* ids, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (IsAlive(ids[i]))
+            DestroyParticle(ids[i]);
+    }
+}
+
+/**
+ * @brief Moves every particle to a new dense index
+ *
+ * @param order the old dense index of every new dense index, a permutation of [0, size())
+ *
+ * @details
+ * Permutes m_Particles, m_Attributes and m_IDlist and updates m_Sparse, so every id keeps
+ * its particle. The addresses of the dense arrays do not change.
+ *
+ * On the cpu every particle may have moved, so the whole dense array becomes dirty. When
+ * the particles are gpu resident the caller permutes the gpu copy the same way, after the
+ * pending moves and dirty ranges were uploaded, see ComputeShader::Reorder.
+ */
+void ParticleSystem::ApplyPermutation(const std::vector<unsigned int>& order)
+{
+    if (order.size() != m_Particles.size())
+    {
+        std::cerr << "Permutation of " << order.size() << " particles does not match " << m_Particles.size() << " particles!" << std::endl;
+        return;
+    }
+
+    std::vector<Particle> particles(m_Particles);
+    std::vector<ParticleAttributes> attributes(m_Attributes);
+    std::vector<unsigned int> ids(m_IDlist);
+
+    for (unsigned int index = 0; index < (unsigned int)order.size(); index++)
+    {
+        m_Particles[index] = particles[order[index]];
+        m_Attributes[index] = attributes[order[index]];
+        m_IDlist[index] = ids[order[index]];
+        m_Sparse[m_IDlist[index]] = index;
+    }
+
+    if (!m_GpuResident && !m_Particles.empty())
+    {
+        m_DirtyRanges.clear();
+        m_DirtyRanges.emplace_back(0, (unsigned int)m_Particles.size());
+        m_DirtyFlags.assign(m_Particles.size(), 1);
+    }
+    m_LayoutVersion++;
 }
 
 /**
@@ -118,4 +279,121 @@ void ParticleSystem::PrintIDlist()
     std::cout << "\n" << std::endl;
 }
 
+/**
+ * @brief Mark a dense index as changed since the last upload
+ * 
+ * @param index the dense index
+ * 
+ * @details
+ * Extends the last range when the index follows it, which is the case for
+ * particles created one after another. Other indices start a new range.
+ * The flag of the index is set too, so IsDirty does not search the ranges.
+ */
+void ParticleSystem::MarkDirty(unsigned int index)
+{
+    if (index >= m_DirtyFlags.size())
+        m_DirtyFlags.resize(std::max((size_t)index + 1, m_Particles.size()), 0);
+    m_DirtyFlags[index] = 1;
+
+    if (!m_DirtyRanges.empty())
+    {
+        std::pair<unsigned int, unsigned int>& last = m_DirtyRanges.back();
+        if (index >= last.first && index <= last.second)
+        {
+            last.second = std::max(last.second, index + 1);
+            return;
+        }
+    }
+    m_DirtyRanges.emplace_back(index, index + 1);
+}
+
+/**
+ * @brief Remove an index from the dirty ranges
+ * 
+ * @param index dense index that must not be uploaded
+ * 
+ * @details
+ * Used when a gpu move overwrites the index, uploading the cpu copy after
+ * the move would undo it. Only clears the flag in O(1), MergeDirtyRanges
+ * splits the ranges around it.
+ */
+void ParticleSystem::UnmarkDirty(unsigned int index)
+{
+    if (index < m_DirtyFlags.size())
+        m_DirtyFlags[index] = 0;
+}
+
+/**
+ * @brief Check if an index is dirty
+ * 
+ * @param index dense index
+ * @return true when the cpu copy of the particle is newer than the gpu copy
+ */
+bool ParticleSystem::IsDirty(unsigned int index) const
+{
+    return index < m_DirtyFlags.size() && m_DirtyFlags[index] != 0;
+}
 
+/**
+ * @brief Forget the dirty ranges after an upload
+ * 
+ * @details
+ * Clears the flags inside the ranges, so the cost follows the uploaded particles.
+ */
+void ParticleSystem::ClearDirtyRanges()
+{
+    for (const std::pair<unsigned int, unsigned int>& range : m_DirtyRanges)
+    {
+        unsigned int end = std::min(range.second, (unsigned int)m_DirtyFlags.size());
+        for (unsigned int index = range.first; index < end; index++)
+            m_DirtyFlags[index] = 0;
+    }
+    m_DirtyRanges.clear();
+}
+
+/**
+ * @brief Sort the dirty ranges and merge the ones that overlap or touch
+ * 
+ * @details
+ * Ranges past the current particle count are dropped or cut off, those
+ * particles were destroyed after they were marked. The ranges are then split
+ * around the indices UnmarkDirty cleared.
+ */
+void ParticleSystem::MergeDirtyRanges()
+{
+    unsigned int count = (unsigned int)m_Particles.size();
+    std::sort(m_DirtyRanges.begin(), m_DirtyRanges.end());
+
+    size_t merged = 0;
+    for (size_t i = 0; i < m_DirtyRanges.size(); i++)
+    {
+        std::pair<unsigned int, unsigned int> range = m_DirtyRanges[i];
+        range.second = std::min(range.second, count);
+        if (range.first >= range.second)
+            continue;
+
+        if (merged > 0 && range.first <= m_DirtyRanges[merged - 1].second)
+            m_DirtyRanges[merged - 1].second = std::max(m_DirtyRanges[merged - 1].second, range.second);
+        else
+            m_DirtyRanges[merged++] = range;
+    }
+    m_DirtyRanges.resize(merged);
+
+    std::vector<std::pair<unsigned int, unsigned int>> split;
+    split.reserve(m_DirtyRanges.size());
+    for (const std::pair<unsigned int, unsigned int>& range : m_DirtyRanges)
+    {
+        unsigned int index = range.first;
+        while (index < range.second)
+        {
+            while (index < range.second && !IsDirty(index))
+                index++;
+            unsigned int begin = index;
+            while (index < range.second && IsDirty(index))
+                index++;
+            if (begin < index)
+                split.emplace_back(begin, index);
+        }
+    }
+    m_DirtyRanges.swap(split);
+}
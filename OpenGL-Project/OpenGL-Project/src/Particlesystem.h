@@ -36,6 +36,31 @@
   * The ParticleSystem class manages a collection of particles in the simulation. It provides
   * functionality for creating new particles, updating their properties, and destroying them.
   * The class also maintains a list of unique identifiers for each particle in the system.
+  *
+  * Every particle is split in a Particle with the properties of the simulation step and
+  * a ParticleAttributes with the rest, m_Particles and m_Attributes are parallel arrays.
+  *
+  * The particles are stored as a sparse set: m_Particles is dense and m_IDlist holds the id
+  * of every dense entry, m_Sparse maps an id back to its dense index. Destroying a particle
+  * moves the last particle into the hole, so creating and destroying are O(1). The dense
+  * array is reserved for the maximum number of particles, so its address only changes
+  * when the capacity grows. Without free ids CreateParticle doubles the capacity.
+  *
+  * Creating and destroying record the dense indices they change as dirty ranges, so an
+  * upload only has to send those particles to the gpu.
+  *
+  * Destroying a particle moves particles to another dense index and increments the layout
+  * version, a copy of the particles taken before that no longer matches the dense array.
+  *
+  * When the particles are gpu resident the gpu holds the only current state and the dense
+  * array is just as old as the last readback. Destroying then records the move of the last
+  * particle as a (source, destination) pair, which is applied on the gpu before the dirty
+  * ranges are uploaded, instead of copying the outdated particle on the cpu.
+ * ComputeShader::Update marks the particles gpu resident, a full synchronous
+ * ComputeShader::RetrieveData makes the dense array current again and unmarks them.
+  *
+  * ApplyPermutation moves all particles at once, to sort them by position for memory
+  * locality, see MortonOrder.
   */
 class ParticleSystem
 {
@@ -46,31 +71,69 @@ public:
 	size_t size() const { return m_Particles.size(); }
 	Particle* data() { return m_Particles.data(); }  
 	const Particle* data() const { return m_Particles.data(); }
+	ParticleAttributes* attributes() { return m_Attributes.data(); }
+	const ParticleAttributes* attributes() const { return m_Attributes.data(); }
 
 	std::vector<unsigned int> IDlistData() { return m_IDlist; }
 
 	size_t CreateParticle(glm::vec3 pos, glm::vec3 vel, glm::vec3 acc, float m, float r, glm::vec4 color);
 	void DestroyParticle(unsigned int id);
+	void DestroyParticles(const unsigned int* ids, size_t count);
+	void DestroyParticles(const std::vector<unsigned int>& ids) { DestroyParticles(ids.data(), ids.size()); }
+
+	void ApplyPermutation(const std::vector<unsigned int>& order);
+
+	bool IsAlive(unsigned int id) const { return id < m_Sparse.size() && m_Sparse[id] != INVALID_INDEX; }
+	unsigned int GetIndex(unsigned int id) const { return m_Sparse[id]; }
 
 	void PrintIDlist();
+
+	const std::vector<std::pair<unsigned int, unsigned int>>& GetDirtyRanges() const { return m_DirtyRanges; }
+	void MergeDirtyRanges();
+	void ClearDirtyRanges();
+	unsigned int GetLayoutVersion() const { return m_LayoutVersion; }
+
+	void SetGpuResident(bool resident) { m_GpuResident = resident; }
+	bool IsGpuResident() const { return m_GpuResident; }
+	const std::vector<std::pair<unsigned int, unsigned int>>& GetMoves() const { return m_Moves; }
+	void ClearMoves() { m_Moves.clear(); }
 	unsigned int GetParticleCount() const { return m_Particles.size(); };
 	
-	void InitFreelist() { for (int i = m_MaxParticles - 1; i >= 0; --i) { m_Freelist.push(i); }	}
+	void InitFreelist();
 
 	unsigned int GetMaxNumber() const { return m_MaxParticles; }
 
-	void MemorySize(unsigned int size) { m_MaxParticles = size; }
+	void MemorySize(unsigned int size);
+	bool Grow(unsigned int capacity);
+	void SetAutoGrow(bool autoGrow) { m_AutoGrow = autoGrow; }
 
-	Particle ReturnParticle(unsigned int id) { return m_Particles[id]; }
+	Particle ReturnParticle(unsigned int id) { return m_Particles[m_Sparse[id]]; }
 	unsigned int ReturnVectorSize(void) { return m_Particles.size(); }
 
+	static const unsigned int INVALID_INDEX = 0xFFFFFFFF;
+	static const unsigned int GROWTH_FACTOR = 2;	///< capacity multiplier when CreateParticle finds no free id
+
 private:
+	void MarkDirty(unsigned int index);
+	void UnmarkDirty(unsigned int index);
+	bool IsDirty(unsigned int index) const;
+
 	std::vector<Particle> m_Particles;  ///< Collection of pointers to particles in the system.
+	std::vector<ParticleAttributes> m_Attributes;	///< m_Attributes[i] belongs to m_Particles[i]
 	unsigned int m_ParticleCount = 0;	///< The current count of particles (initialized as 0).
 
-	std::vector<unsigned int> m_IDlist;	///< list van alle id's 
+	std::vector<unsigned int> m_IDlist;	///< list van alle id's, m_IDlist[i] is the id of m_Particles[i]
+	std::vector<unsigned int> m_Sparse;	///< dense index of every id, INVALID_INDEX when the id is free
+
+	std::vector<std::pair<unsigned int, unsigned int>> m_DirtyRanges;	///< [begin, end) dense index ranges changed since the last upload
+	std::vector<unsigned char> m_DirtyFlags;	///< 1 per dense index that is dirty, the ranges may also cover unmarked indices
+	unsigned int m_LayoutVersion = 0;	///< incremented every time particles change dense index
+
+	bool m_GpuResident = false;			///< the gpu holds the current particles, the cpu copy is outdated
+	std::vector<std::pair<unsigned int, unsigned int>> m_Moves;	///< (source, destination) dense index copies to apply on the gpu, in order
 
 	size_t m_MaxParticles = 100000;
+	bool m_AutoGrow = true;				///< grow the capacity when CreateParticle finds no free id
 	std::stack<size_t> m_Freelist;
 
 	unsigned int m_NewestParticleID = 0;
@@ -0,0 +1,203 @@
+/**
+ * @file ProgramCache.cpp
+ * @brief This file contains the implementation for the ProgramCache class.
+ *
+ * @details This file contains the method definitions for hashing shader sources
+ * and storing and loading program binaries.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "ProgramCache.h"
+
+#include "GLmacros.h"
+
+#include <iostream>
+#include <algorithm>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <cstdint>
+
+std::string ProgramCache::s_Directory = "res/shaders/cache/";
+
+/// Check if format is one of the GL_PROGRAM_BINARY_FORMATS of the driver
+static bool IsFormatSupported(GLenum format)
+{
+    GLint count = 0;
+    GLCall(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count));
+    if (count <= 0)
+        return false;
+
+    std::vector<GLint> formats(count);
+    GLCall(glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data()));
+    return std::find(formats.begin(), formats.end(), (GLint)format) != formats.end();
+}
+
+/// 64 bit FNV-1a, continues from hash
+static uint64_t Fnv1a(const std::string& data, uint64_t hash)
+{
+    for (unsigned char c : data)
+    {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Hash the sources of a program and the driver into a cache key
+ *
+ * @param sources every stage of the program as it is compiled, with the injected defines
+ * @return std::string 16 hex digits
+ *
+ * @details
+ * The length of every source is hashed too, so moving text from one stage to the
+ * next gives another key.
+ */
+std::string ProgramCache::Key(const std::vector<std::string>& sources)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (const std::string& source : sources)
+    {
+        hash = Fnv1a(std::to_string(source.size()), hash);
+        hash = Fnv1a(source, hash);
+    }
+    hash = Fnv1a(DriverKey(), hash);
+
+    std::stringstream key;
+    key << std::hex << std::setw(16) << std::setfill('0') << hash;
+    return key.str();
+}
+
+/**
+ * @brief Create a program from a cached binary
+ *
+ * @param key key of the program
+ * @return unsigned int the linked program, 0 when it is not cached or the driver rejects the binary
+ *
+ * @details
+ * A binary the driver rejects, for example after an update that kept the version
+ * string, is overwritten by the next Store. A format the driver does not list in
+ * GL_PROGRAM_BINARY_FORMATS is skipped before glProgramBinary, which would raise
+ * GL_INVALID_ENUM and stop a GL_DEBUG_SYNC build in the debug callback.
+ */
+unsigned int ProgramCache::Load(const std::string& key)
+{
+    if (!IsSupported())
+        return 0;
+
+    std::ifstream file(FilePath(key), std::ios::binary);
+    if (!file)
+        return 0;
+
+    GLenum format = 0;
+    file.read((char*)&format, sizeof(format));
+    if (!file)
+        return 0;
+
+    std::vector<char> binary((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (binary.empty())
+        return 0;
+
+    if (!IsFormatSupported(format))
+    {
+        std::cout << "Cached program " << key << " has an unknown binary format, compiling from source." << std::endl;
+        return 0;
+    }
+
+    GLCall(unsigned int program = glCreateProgram());
+    GLCall(glProgramBinary(program, format, binary.data(), (GLsizei)binary.size()));
+
+    int linked = GL_FALSE;
+    GLCall(glGetProgramiv(program, GL_LINK_STATUS, &linked));
+    if (linked == GL_FALSE)
+    {
+        std::cout << "Cached program " << key << " was rejected, compiling from source." << std::endl;
+        glDeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
+
+/**
+ * @brief Store the binary of a linked program
+ *
+ * @param key key of the program
+ * @param program program linked with GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+ *
+ * @details
+ * Programs that did not link are not stored, so a shader error is reported on every start.
+ */
+void ProgramCache::Store(const std::string& key, unsigned int program)
+{
+    if (!IsSupported() || program == 0)
+        return;
+
+    int linked = GL_FALSE;
+    int length = 0;
+    GLCall(glGetProgramiv(program, GL_LINK_STATUS, &linked));
+    GLCall(glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length));
+    if (linked == GL_FALSE || length <= 0)
+        return;
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLCall(glGetProgramBinary(program, length, &length, &format, binary.data()));
+
+    std::ofstream file(FilePath(key), std::ios::binary | std::ios::trunc);
+    if (!file)
+    {
+        std::cerr << "Can not write program cache " << FilePath(key) << std::endl;
+        return;
+    }
+    file.write((const char*)&format, sizeof(format));
+    file.write(binary.data(), length);
+}
+
+/**
+ * @brief Check if the driver can save program binaries
+ *
+ * @return true when the driver reports at least one binary format
+ */
+bool ProgramCache::IsSupported()
+{
+    if (!(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+        return false;
+
+    GLint formats = 0;
+    GLCall(glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats));
+    return formats > 0;
+}
+
+/**
+ * @brief Vendor, renderer and version of the OpenGL driver
+ *
+ * @return std::string the three strings separated by " | "
+ *
+ * @details
+ * Binaries and tuned settings are only valid for the driver that made them.
+ */
+std::string ProgramCache::DriverKey()
+{
+    const char* vendor = (const char*)glGetString(GL_VENDOR);
+    const char* renderer = (const char*)glGetString(GL_RENDERER);
+    const char* version = (const char*)glGetString(GL_VERSION);
+
+    std::stringstream key;
+    key << (vendor ? vendor : "?") << " | " << (renderer ? renderer : "?") << " | " << (version ? version : "?");
+    return key.str();
+}
+
+/**
+ * @brief Path of the cache file of a key
+ */
+std::string ProgramCache::FilePath(const std::string& key)
+{
+    return s_Directory + key + ".bin";
+}
@@ -0,0 +1,50 @@
+/**
+ * @file ProgramCache.h
+ * @brief This file contains the ProgramCache class and its methods.
+ *
+ * @details This file contains the ProgramCache class which stores linked shader
+ * programs on disk, so Shader and ComputeShader do not compile them on every start.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * @class ProgramCache
+ * @brief Disk cache of linked program binaries
+ *
+ * @details
+ * A program is stored with glGetProgramBinary in a file named after the key, a
+ * 64 bit FNV-1a hash of every source with its injected defines and the vendor,
+ * renderer and version of the driver. So an edited shader, another variant or a
+ * driver update gives another key and the program is compiled again.
+ *
+ * Load returns 0 when there is no binary or the driver rejects it, then the caller
+ * compiles from source and calls Store. Drivers without binary formats disable the cache.
+ */
+class ProgramCache
+{
+public:
+	static std::string Key(const std::vector<std::string>& sources);
+	static unsigned int Load(const std::string& key);
+	static void Store(const std::string& key, unsigned int program);
+
+	static bool IsSupported();
+	static std::string DriverKey();
+
+	static void SetDirectory(const std::string& directory) { s_Directory = directory; }
+	static const std::string& GetDirectory() { return s_Directory; }
+
+private:
+	static std::string FilePath(const std::string& key);
+
+	static std::string s_Directory;		///< must exist, ends with a slash
+};
@@ -55,6 +55,41 @@ void Renderer::DrawInstanced(const VertexArray& va, const IndexBuffer& ib, const
     shader.Bind();
     va.Bind();
     ib.Bind();
-    GLCall(glDrawElementsInstanced(GL_TRIANGLES, ib.GetCount(), GL_UNSIGNED_INT, nullptr, count))
+    GLCall(glDrawElementsInstanced(GL_TRIANGLES, ib.GetCount(), GL_UNSIGNED_INT, nullptr, count));
 }
 
+/**
+ * @brief Draw one instance per particle
+ * 
+ * @param mode how a particle is drawn
+ * @param va vertex array, bound for every mode
+ * @param ib index buffer of the mesh, only used by ParticleDrawMode::Mesh
+ * @param shader shader, for Quad and Point a sprite shader
+ * @param count number of particles
+ * 
+ * @details
+ * Mesh draws the indexed mesh per particle. Quad draws 4 vertices and Point 1 vertex
+ * per particle, gl_PointSize is enabled for the Point mode. The size of a point is
+ * limited by GL_POINT_SIZE_RANGE, Quad has no limit.
+ */
+void Renderer::DrawParticles(ParticleDrawMode mode, const VertexArray& va, const IndexBuffer& ib, const Shader& shader, unsigned int count) const
+{
+    switch (mode)
+    {
+    case ParticleDrawMode::Mesh:
+        DrawInstanced(va, ib, shader, count);
+        break;
+    case ParticleDrawMode::Quad:
+        shader.Bind();
+        va.Bind();
+        GLCall(glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count));
+        break;
+    case ParticleDrawMode::Point:
+        shader.Bind();
+        va.Bind();
+        GLCall(glEnable(GL_PROGRAM_POINT_SIZE));
+        GLCall(glDrawArraysInstanced(GL_POINTS, 0, 1, count));
+        GLCall(glDisable(GL_PROGRAM_POINT_SIZE));
+        break;
+    }
+}
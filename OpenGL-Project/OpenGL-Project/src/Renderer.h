@@ -21,6 +21,16 @@
 #include "ComputeShader.h"
 #include "GLmacros.h"
 
+/**
+ * @brief How DrawParticles turns a particle into triangles
+ */
+enum class ParticleDrawMode
+{
+	Mesh,		///< the indexed mesh of the vertex array per instance
+	Quad,		///< a 4 vertex triangle strip per instance, the disc is shaded in the fragment shader
+	Point		///< one GL_POINTS vertex per instance, the disc is shaded in the fragment shader
+};
+
 /**
  * @class Renderer
  * @brief Renderer class
@@ -31,6 +41,10 @@
  * 
  * The ComputeShader class is used to  bind and unbind shaders.
  * The class also includes the method for drawing the vertex array.
+ *
+ * DrawParticles draws one instance per particle in the chosen ParticleDrawMode.
+ * Quad and Point need a shader that builds the vertices from gl_VertexID and
+ * gl_InstanceID, like SpriteVertex.glsl, the vertex array is only bound.
  */
 class Renderer
 {
@@ -38,4 +52,5 @@ public:
     void Clear() const;
     void Draw(const VertexArray& va, const IndexBuffer& ib, const Shader& shader) const;
     void DrawInstanced(const VertexArray& va, const IndexBuffer& ib, const Shader& shader, unsigned int count) const;
+    void DrawParticles(ParticleDrawMode mode, const VertexArray& va, const IndexBuffer& ib, const Shader& shader, unsigned int count) const;
 };
\ No newline at end of file
@@ -15,6 +15,7 @@
 #include "Shader.h"
 
 #include "GLmacros.h"
+#include "ProgramCache.h"
 
 #include <iostream>
 #include <fstream>
@@ -129,14 +130,22 @@ unsigned int Shader::CompileShader(unsigned int type, const std::string& source)
  * 
  * @details
  * Create a shader program
+ * The program is loaded from the ProgramCache when it holds a binary of the same
+ * sources for this driver, otherwise it is compiled and stored in the cache.
  */
 unsigned int Shader::CreateShader(const std::string& vertexShader, const std::string& fragmentShader)
 {
-    unsigned int program = glCreateProgram();
-
     std::string shadercode_vertex = ReadShaderFile(vertexShader);
     std::string shadercode_fragment = ReadShaderFile(fragmentShader);
 
+    std::string key = ProgramCache::Key({ shadercode_vertex, shadercode_fragment });
+    unsigned int cached = ProgramCache::Load(key);
+    if (cached != 0)
+        return cached;
+
+    unsigned int program = glCreateProgram();
+    glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+
     unsigned int vs = CompileShader(GL_VERTEX_SHADER, shadercode_vertex);
     unsigned int fs = CompileShader(GL_FRAGMENT_SHADER, shadercode_fragment);
 
@@ -149,6 +158,7 @@ unsigned int Shader::CreateShader(const std::string& vertexShader, const std::st
     glDeleteShader(vs);
     glDeleteShader(fs);
 
+    ProgramCache::Store(key, program);
     return program;
 }
 
@@ -0,0 +1,108 @@
+/**
+ * @file SimConfig.h
+ * @brief Configuration of the simulation.
+ *
+ * @details SIM_DIM selects a 2D or 3D simulation. It defaults to 2, the main
+ * workload, and can be set to 3 in the project settings. ComputeShader injects
+ * the same value as DIM into Compute.glsl, so the Particle layouts always match.
+ * Integrator selects the integration scheme and ForceMode the forces between the
+ * particles at runtime.
+ * SimParams holds the parameters of a simulation step that can change at runtime.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include "vendor/glm/glm.hpp"
+
+#ifndef SIM_DIM
+#define SIM_DIM 2
+#endif
+
+static_assert(SIM_DIM == 2 || SIM_DIM == 3, "SIM_DIM must be 2 or 3");
+
+/// Position and velocity of a particle, glm::vec2 in 2D and glm::vec3 in 3D
+typedef glm::vec<SIM_DIM, float> SimVec;
+
+/// Drop the components a 2D simulation does not have
+inline SimVec ToSimVec(const glm::vec3& v)
+{
+	SimVec result;
+	for (int axis = 0; axis < SIM_DIM; axis++) { result[axis] = v[axis]; }
+	return result;
+}
+
+/// Widen to 3 components, z is 0 in a 2D simulation
+inline glm::vec3 ToVec3(const SimVec& v)
+{
+	glm::vec3 result(0.0f);
+	for (int axis = 0; axis < SIM_DIM; axis++) { result[axis] = v[axis]; }
+	return result;
+}
+
+/**
+ * @brief Integration scheme of the simulation step, must match the INTEGRATOR_ defines in Compute.glsl
+ *
+ * @details
+ * The Verlet schemes keep the state of the last step in the past fields of ParticleAttributes.
+ * They stay stable at larger time steps than Euler, but need a fixed time step to be exact.
+ */
+enum class Integrator
+{
+	Euler = 0,			///< pos += vel * dt + acc * dt^2 / 2, vel += acc * dt
+	PositionVerlet,		///< Stormer-Verlet from the current and the past position
+	VelocityVerlet		///< the velocity is completed with the past and the current acceleration
+};
+
+/**
+ * @brief Force between the particles besides the collisions, must match the FORCE_ defines in Compute.glsl
+ *
+ * @details
+ * ComputeShader compiles a variant of Compute.glsl per mode, the buffers of a mode
+ * only exist in its variant.
+ */
+enum class ForceMode
+{
+	None = 0,			///< only the acceleration of the particle and the gravity of SimParams
+	BarnesHut,			///< mutual gravity of the particle masses, approximated with a BarnesHutTree built on the cpu, ComputeShader reads the particles back for it once per Update
+	ParticleMesh,		///< mutual gravity of the particle masses, solved on the grid of a ParticleMesh
+	AllPairs			///< exact mutual gravity, every particle against every other particle
+};
+
+/**
+ * @brief Parameters of the simulation step, std140 layout of the SimParams block in Compute.glsl
+ *
+ * @details
+ * ComputeShader writes it once per Update into a uniform buffer. The bounds and
+ * gravity are vec4 to keep the std140 layout equal in 2D and 3D.
+ */
+struct SimParams
+{
+	glm::vec4 screenMin = { -0.5f, -0.5f, 0.0f, 0.0f };	///< lower corner of the walls
+	glm::vec4 screenMax = { 800.0f, 600.0f, 0.0f, 0.0f };	///< upper corner of the walls
+	glm::vec4 gravity = { 0.0f, 0.0f, 0.0f, 0.0f };		///< added to the acceleration of every particle
+
+	glm::vec2 gridMin = { 0.0f, 0.0f };
+	glm::ivec2 gridDim = { 0, 0 };
+
+	float deltaTime = 0.0f;
+	float cellSize = 0.0f;
+	float frictionW = 0.95f;			///< velocity kept after bouncing off a wall
+	float frictionP = 0.96f;			///< velocity kept after a particle collision
+
+	unsigned int particleCount = 0;
+	int integrator = (int)Integrator::Euler;
+	float gravityConstant = 1.0f;		///< G of the mutual gravity
+	float softening = 1.0f;			///< added to the distance of the mutual gravity as sqrt(r^2 + softening^2)
+
+	float openingAngle = 0.5f;		///< cells smaller than openingAngle times their distance are not opened
+	float pmCellSize = 1.0f;		///< cell size of the particle mesh, its grid starts at screenMin
+	float padding[2] = { 0.0f, 0.0f };
+};
+
+static_assert(sizeof(SimParams) == 112, "SimParams must match the SimParams block in Compute.glsl");
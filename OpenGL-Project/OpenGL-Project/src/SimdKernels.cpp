@@ -0,0 +1,320 @@
+/**
+ * @file SimdKernels.cpp
+ * @brief This file contains the implementation of the SIMD kernels.
+ *
+ * @details Every kernel has a scalar, SSE, AVX2 and AVX-512 version. The vector
+ * versions do the same operations in the same order as the scalar version and
+ * do not use fused multiply-add, so all versions give bitwise identical results.
+ * The remainder of a range that does not fill a vector is done by the scalar version.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "SimdKernels.h"
+
+#include <algorithm>
+#include <immintrin.h>
+
+// GCC contracts the multiplies and adds into fma for AVX-512, which changes the rounding
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define SIMD_TARGET(x)
+#elif defined(__clang__)
+#define SIMD_TARGET(x) __attribute__((target(x)))
+#else
+#define SIMD_TARGET(x) __attribute__((target(x), optimize("fp-contract=off")))
+#endif
+
+static SimdLevel s_SimdLevel = DetectSimdLevel();
+
+/**
+ * @brief Detect the widest instruction set supported by the cpu and the os
+ *
+ * @return SimdLevel the detected level
+ */
+SimdLevel DetectSimdLevel()
+{
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 0);
+    int maxLeaf = info[0];
+
+    __cpuid(info, 1);
+    bool sse = (info[3] & (1 << 25)) != 0;
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+
+    unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+    bool ymmState = (xcr0 & 0x6) == 0x6;
+    bool zmmState = (xcr0 & 0xE6) == 0xE6;
+
+    bool avx2 = false, avx512 = false;
+    if (maxLeaf >= 7)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+        avx512 = (info[1] & (1 << 16)) != 0;
+    }
+
+    if (avx512 && zmmState) return SimdLevel::AVX512;
+    if (avx2 && avx && ymmState) return SimdLevel::AVX2;
+    if (sse) return SimdLevel::SSE;
+    return SimdLevel::Scalar;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) return SimdLevel::AVX512;
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+    if (__builtin_cpu_supports("sse")) return SimdLevel::SSE;
+    return SimdLevel::Scalar;
+#endif
+}
+
+/**
+ * @brief Get the instruction set used by the kernels
+ */
+SimdLevel GetSimdLevel()
+{
+    return s_SimdLevel;
+}
+
+/**
+ * @brief Select the instruction set used by the kernels
+ *
+ * @param level the requested level, lowered to what the cpu supports
+ */
+void SetSimdLevel(SimdLevel level)
+{
+    s_SimdLevel = std::min(level, DetectSimdLevel());
+}
+
+/**
+ * @brief Get the name of an instruction set
+ */
+const char* SimdLevelName(SimdLevel level)
+{
+    switch (level)
+    {
+    case SimdLevel::SSE:    return "SSE";
+    case SimdLevel::AVX2:   return "AVX2";
+    case SimdLevel::AVX512: return "AVX-512";
+    default:                return "Scalar";
+    }
+}
+
+static void IntegrateScalar(float* pos, float* vel, const float* acc, size_t begin, size_t end, float deltaTime)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        pos[i] = pos[i] + vel[i] * deltaTime + ((acc[i] * deltaTime * deltaTime) / 2.0f);
+        vel[i] = acc[i] * deltaTime + vel[i];
+    }
+}
+
+static void CollideWallScalar(float* pos, float* vel, const float* radius, size_t begin, size_t end, float boundsMin, float boundsMax, float friction)
+{
+    for (size_t i = begin; i < end; i++)
+    {
+        if (pos[i] - radius[i] < boundsMin || pos[i] + radius[i] > boundsMax)
+        {
+            vel[i] = -vel[i] * friction;
+            pos[i] = std::min(std::max(pos[i], boundsMin + radius[i]), boundsMax - radius[i]);
+        }
+    }
+}
+
+SIMD_TARGET("sse")
+static size_t IntegrateSSE(float* pos, float* vel, const float* acc, size_t count, float deltaTime)
+{
+    const __m128 dt = _mm_set1_ps(deltaTime);
+    const __m128 two = _mm_set1_ps(2.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 p = _mm_loadu_ps(pos + i);
+        __m128 v = _mm_loadu_ps(vel + i);
+        __m128 a = _mm_loadu_ps(acc + i);
+
+        __m128 half = _mm_div_ps(_mm_mul_ps(_mm_mul_ps(a, dt), dt), two);
+        p = _mm_add_ps(_mm_add_ps(p, _mm_mul_ps(v, dt)), half);
+        v = _mm_add_ps(_mm_mul_ps(a, dt), v);
+
+        _mm_storeu_ps(pos + i, p);
+        _mm_storeu_ps(vel + i, v);
+    }
+    return i;
+}
+
+SIMD_TARGET("sse")
+static size_t CollideWallSSE(float* pos, float* vel, const float* radius, size_t count, float boundsMin, float boundsMax, float friction)
+{
+    const __m128 lo = _mm_set1_ps(boundsMin);
+    const __m128 hi = _mm_set1_ps(boundsMax);
+    const __m128 f = _mm_set1_ps(friction);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 p = _mm_loadu_ps(pos + i);
+        __m128 v = _mm_loadu_ps(vel + i);
+        __m128 r = _mm_loadu_ps(radius + i);
+
+        __m128 hit = _mm_or_ps(_mm_cmplt_ps(_mm_sub_ps(p, r), lo), _mm_cmpgt_ps(_mm_add_ps(p, r), hi));
+        __m128 bounced = _mm_mul_ps(_mm_xor_ps(v, sign), f);
+        __m128 clamped = _mm_min_ps(_mm_max_ps(p, _mm_add_ps(lo, r)), _mm_sub_ps(hi, r));
+
+        _mm_storeu_ps(vel + i, _mm_or_ps(_mm_and_ps(hit, bounced), _mm_andnot_ps(hit, v)));
+        _mm_storeu_ps(pos + i, _mm_or_ps(_mm_and_ps(hit, clamped), _mm_andnot_ps(hit, p)));
+    }
+    return i;
+}
+
+SIMD_TARGET("avx2")
+static size_t IntegrateAVX2(float* pos, float* vel, const float* acc, size_t count, float deltaTime)
+{
+    const __m256 dt = _mm256_set1_ps(deltaTime);
+    const __m256 two = _mm256_set1_ps(2.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 p = _mm256_loadu_ps(pos + i);
+        __m256 v = _mm256_loadu_ps(vel + i);
+        __m256 a = _mm256_loadu_ps(acc + i);
+
+        __m256 half = _mm256_div_ps(_mm256_mul_ps(_mm256_mul_ps(a, dt), dt), two);
+        p = _mm256_add_ps(_mm256_add_ps(p, _mm256_mul_ps(v, dt)), half);
+        v = _mm256_add_ps(_mm256_mul_ps(a, dt), v);
+
+        _mm256_storeu_ps(pos + i, p);
+        _mm256_storeu_ps(vel + i, v);
+    }
+    return i;
+}
+
+SIMD_TARGET("avx2")
+static size_t CollideWallAVX2(float* pos, float* vel, const float* radius, size_t count, float boundsMin, float boundsMax, float friction)
+{
+    const __m256 lo = _mm256_set1_ps(boundsMin);
+    const __m256 hi = _mm256_set1_ps(boundsMax);
+    const __m256 f = _mm256_set1_ps(friction);
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256 p = _mm256_loadu_ps(pos + i);
+        __m256 v = _mm256_loadu_ps(vel + i);
+        __m256 r = _mm256_loadu_ps(radius + i);
+
+        __m256 hit = _mm256_or_ps(_mm256_cmp_ps(_mm256_sub_ps(p, r), lo, _CMP_LT_OQ), _mm256_cmp_ps(_mm256_add_ps(p, r), hi, _CMP_GT_OQ));
+        __m256 bounced = _mm256_mul_ps(_mm256_xor_ps(v, sign), f);
+        __m256 clamped = _mm256_min_ps(_mm256_max_ps(p, _mm256_add_ps(lo, r)), _mm256_sub_ps(hi, r));
+
+        _mm256_storeu_ps(vel + i, _mm256_blendv_ps(v, bounced, hit));
+        _mm256_storeu_ps(pos + i, _mm256_blendv_ps(p, clamped, hit));
+    }
+    return i;
+}
+
+SIMD_TARGET("avx512f")
+static size_t IntegrateAVX512(float* pos, float* vel, const float* acc, size_t count, float deltaTime)
+{
+    const __m512 dt = _mm512_set1_ps(deltaTime);
+    const __m512 two = _mm512_set1_ps(2.0f);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 p = _mm512_loadu_ps(pos + i);
+        __m512 v = _mm512_loadu_ps(vel + i);
+        __m512 a = _mm512_loadu_ps(acc + i);
+
+        __m512 half = _mm512_div_ps(_mm512_mul_ps(_mm512_mul_ps(a, dt), dt), two);
+        p = _mm512_add_ps(_mm512_add_ps(p, _mm512_mul_ps(v, dt)), half);
+        v = _mm512_add_ps(_mm512_mul_ps(a, dt), v);
+
+        _mm512_storeu_ps(pos + i, p);
+        _mm512_storeu_ps(vel + i, v);
+    }
+    return i;
+}
+
+SIMD_TARGET("avx512f")
+static size_t CollideWallAVX512(float* pos, float* vel, const float* radius, size_t count, float boundsMin, float boundsMax, float friction)
+{
+    const __m512 lo = _mm512_set1_ps(boundsMin);
+    const __m512 hi = _mm512_set1_ps(boundsMax);
+    const __m512 f = _mm512_set1_ps(friction);
+    const __m512i sign = _mm512_set1_epi32((int)0x80000000);
+
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16)
+    {
+        __m512 p = _mm512_loadu_ps(pos + i);
+        __m512 v = _mm512_loadu_ps(vel + i);
+        __m512 r = _mm512_loadu_ps(radius + i);
+
+        __mmask16 hit = _mm512_cmp_ps_mask(_mm512_sub_ps(p, r), lo, _CMP_LT_OQ) | _mm512_cmp_ps_mask(_mm512_add_ps(p, r), hi, _CMP_GT_OQ);
+        __m512 bounced = _mm512_mul_ps(_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(v), sign)), f);
+        __m512 clamped = _mm512_min_ps(_mm512_max_ps(p, _mm512_add_ps(lo, r)), _mm512_sub_ps(hi, r));
+
+        _mm512_storeu_ps(vel + i, _mm512_mask_blend_ps(hit, v, bounced));
+        _mm512_storeu_ps(pos + i, _mm512_mask_blend_ps(hit, p, clamped));
+    }
+    return i;
+}
+
+/**
+ * @brief Integrate one axis of count particles
+ *
+ * @param pos positions along the axis
+ * @param vel velocities along the axis
+ * @param acc accelerations along the axis
+ * @param count number of particles
+ * @param deltaTime time step
+ */
+void IntegrateSoA(float* pos, float* vel, const float* acc, size_t count, float deltaTime)
+{
+    size_t done = 0;
+    switch (s_SimdLevel)
+    {
+    case SimdLevel::AVX512: done = IntegrateAVX512(pos, vel, acc, count, deltaTime); break;
+    case SimdLevel::AVX2:   done = IntegrateAVX2(pos, vel, acc, count, deltaTime); break;
+    case SimdLevel::SSE:    done = IntegrateSSE(pos, vel, acc, count, deltaTime); break;
+    default: break;
+    }
+    IntegrateScalar(pos, vel, acc, done, count, deltaTime);
+}
+
+/**
+ * @brief Bounce one axis of count particles off the walls
+ *
+ * @param pos positions along the axis
+ * @param vel velocities along the axis
+ * @param radius radii of the particles
+ * @param count number of particles
+ * @param boundsMin lower wall
+ * @param boundsMax upper wall
+ * @param friction velocity factor after a bounce
+ *
+ * @details
+ * Same as CheckCollisionWall in Compute.glsl for a single axis.
+ */
+void CollideWallSoA(float* pos, float* vel, const float* radius, size_t count, float boundsMin, float boundsMax, float friction)
+{
+    size_t done = 0;
+    switch (s_SimdLevel)
+    {
+    case SimdLevel::AVX512: done = CollideWallAVX512(pos, vel, radius, count, boundsMin, boundsMax, friction); break;
+    case SimdLevel::AVX2:   done = CollideWallAVX2(pos, vel, radius, count, boundsMin, boundsMax, friction); break;
+    case SimdLevel::SSE:    done = CollideWallSSE(pos, vel, radius, count, boundsMin, boundsMax, friction); break;
+    default: break;
+    }
+    CollideWallScalar(pos, vel, radius, done, count, boundsMin, boundsMax, friction);
+}
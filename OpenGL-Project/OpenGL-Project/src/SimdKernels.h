@@ -0,0 +1,44 @@
+/**
+ * @file SimdKernels.h
+ * @brief This file contains the SIMD kernels for the structure of arrays particle storage.
+ *
+ * @details This file contains the integrate and wall collision kernels that run
+ * over one axis of a ParticleSoA. The widest instruction set supported by the cpu
+ * (SSE, AVX2 or AVX-512) is selected at runtime.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include <cstddef>
+
+/**
+ * @brief Instruction sets the kernels are compiled for
+ */
+enum class SimdLevel
+{
+	Scalar,
+	SSE,
+	AVX2,
+	AVX512
+};
+
+SimdLevel DetectSimdLevel();
+SimdLevel GetSimdLevel();
+void SetSimdLevel(SimdLevel level);
+const char* SimdLevelName(SimdLevel level);
+
+/**
+ * @brief Integrate one axis: pos += vel * dt + acc * dt * dt / 2, vel += acc * dt
+ */
+void IntegrateSoA(float* pos, float* vel, const float* acc, size_t count, float deltaTime);
+
+/**
+ * @brief Bounce one axis off the walls at boundsMin and boundsMax
+ */
+void CollideWallSoA(float* pos, float* vel, const float* radius, size_t count, float boundsMin, float boundsMax, float friction);
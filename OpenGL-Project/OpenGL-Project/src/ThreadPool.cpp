@@ -0,0 +1,130 @@
+/**
+ * @file ThreadPool.cpp
+ * @brief This file contains the implementation for the ThreadPool class.
+ *
+ * @details This file contains the method definitions for creating the worker
+ * threads and running parallel loops on them.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "ThreadPool.h"
+
+/**
+ * @brief Constructor
+ *
+ * @param threadCount total number of threads including the calling thread,
+ * 0 uses every hardware thread
+ *
+ * @details
+ * Start threadCount - 1 worker threads, the thread calling ParallelFor
+ * does the remaining share of the work.
+ */
+ThreadPool::ThreadPool(unsigned int threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::thread::hardware_concurrency();
+    if (threadCount == 0)
+        threadCount = 1;
+
+    for (unsigned int i = 1; i < threadCount; i++)
+        m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+/**
+ * @brief Destructor
+ *
+ * @details
+ * Wake all workers and wait for them to exit.
+ */
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_StartCondition.notify_all();
+
+    for (std::thread& worker : m_Workers)
+        worker.join();
+}
+
+/**
+ * @brief Run a job over a range on all threads
+ *
+ * @param count size of the range [0, count)
+ * @param job function called with a sub range [begin, end)
+ *
+ * @details
+ * The range is split into one contiguous chunk per thread. The job must only write
+ * to data belonging to its own sub range. Returns when every chunk is done.
+ */
+void ThreadPool::ParallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& job)
+{
+    if (count == 0)
+        return;
+
+    if (m_Workers.empty() || count < GetThreadCount())
+    {
+        job(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Job = &job;
+        m_Count = count;
+        m_Busy = (unsigned int)m_Workers.size();
+        m_Generation++;
+    }
+    m_StartCondition.notify_all();
+
+    job(0, count / GetThreadCount());
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_DoneCondition.wait(lock, [this] { return m_Busy == 0; });
+    m_Job = nullptr;
+}
+
+/**
+ * @brief Main loop of a worker thread
+ *
+ * @param worker index of the chunk this worker processes
+ *
+ * @details
+ * Sleep until a new job is started, process chunk worker of it and
+ * signal ParallelFor when the last worker is done.
+ */
+void ThreadPool::WorkerLoop(unsigned int worker)
+{
+    unsigned long long generation = 0;
+
+    while (true)
+    {
+        const std::function<void(size_t, size_t)>* job;
+        size_t count;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_StartCondition.wait(lock, [this, generation] { return m_Stop || m_Generation != generation; });
+            if (m_Stop)
+                return;
+
+            generation = m_Generation;
+            job = m_Job;
+            count = m_Count;
+        }
+
+        size_t threads = GetThreadCount();
+        (*job)(count * worker / threads, count * (worker + 1) / threads);
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Busy--;
+        }
+        m_DoneCondition.notify_one();
+    }
+}
@@ -0,0 +1,59 @@
+/**
+ * @file ThreadPool.h
+ * @brief This file contains the ThreadPool class and its methods.
+ *
+ * @details This file contains the ThreadPool class which is used to split
+ * loops over the particles across all cores of the cpu.
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#pragma once
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/**
+ * @class ThreadPool
+ * @brief Fixed set of worker threads for parallel loops
+ *
+ * @details
+ * The worker threads are created once and sleep between jobs. ParallelFor splits
+ * a range into one contiguous chunk per thread, the calling thread processes the
+ * first chunk itself and returns when all chunks are done.
+ */
+class ThreadPool
+{
+public:
+	ThreadPool(unsigned int threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int GetThreadCount() const { return (unsigned int)m_Workers.size() + 1; }
+
+	void ParallelFor(size_t count, const std::function<void(size_t begin, size_t end)>& job);
+
+private:
+	void WorkerLoop(unsigned int worker);
+
+	std::vector<std::thread> m_Workers;
+
+	std::mutex m_Mutex;
+	std::condition_variable m_StartCondition;
+	std::condition_variable m_DoneCondition;
+
+	const std::function<void(size_t, size_t)>* m_Job = nullptr;	///< job of the current ParallelFor call
+	size_t m_Count = 0;												///< size of the range of the current job
+	unsigned long long m_Generation = 0;							///< incremented for every job
+	unsigned int m_Busy = 0;										///< workers still running the current job
+	bool m_Stop = false;
+};
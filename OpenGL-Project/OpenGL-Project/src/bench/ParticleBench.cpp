@@ -0,0 +1,571 @@
+/**
+ * @file ParticleBench.cpp
+ * @brief Headless benchmark of the particle simulation.
+ *
+ * @details This file contains the particle_bench executable. It runs fixed scenarios
+ * for a number of steps at several particle counts, without a window or vsync,
+ * and prints the results as JSON.
+ *
+ * The CPU backends (CpuSimulator) are always built, cpu updates a ParticleSystem and
+ * cpu-soa a ParticleSoA. The GPU backend (ComputeShader) is built with PARTICLE_BENCH_GPU
+ * and runs on an offscreen EGL context.
+ *
+ * Every result has a checksum of the particles after the last step. The cpu and cpu-soa
+ * backends must give the same bits, the bench fails when their checksums differ.
+ *
+ * Usage: particle_bench [--backend cpu|cpu-soa|gpu|all] [--scenario uniform|cluster|rain|galaxy|all]
+ *                       [--sizes 1000,10000,...] [--steps K] [--threads T] [--out file.json]
+ *                       [--force barnes-hut|mesh|all-pairs] [--reorder K]
+ *                       [--integrator euler|position-verlet|velocity-verlet]
+ *
+ * For more information, see the documentation at:
+ * @link https://github.com/mennodedam/NLE-Particle-Simulation @endlink
+ *
+ * @date 17-10-2026
+ * @author Menno Eijkelenboom
+ */
+
+#include "CpuSimulator.h"
+#include "ParticleSoA.h"
+#include "Particlesystem.h"
+
+#ifdef PARTICLE_BENCH_GPU
+#include "ComputeShader.h"
+#include "ProgramCache.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef PARTICLE_BENCH_RES
+#define PARTICLE_BENCH_RES "res/"
+#endif
+
+static const glm::vec2 BOUNDS_MIN = { -0.5f, -0.5f };	///< same walls as SimParams
+static const glm::vec2 BOUNDS_MAX = { 800.0f, 600.0f };
+static const float RADIUS = 1.0f;
+static const float CELL_SIZE = 4.0f * RADIUS;
+static const float STEP_SIZE = 0.01f;
+static const glm::vec3 RAIN_GRAVITY = { 0.0f, -200.0f, 0.0f };
+static const float GALAXY_RADIUS = 250.0f;
+static const float GALAXY_MASS = 1000000.0f;		///< total mass, spread over the particles
+static const float GALAXY_SOFTENING = 2.0f;
+static const float GALAXY_OPENING_ANGLE = 0.5f;
+static const size_t PARTICLE_BYTES = sizeof(Particle) + sizeof(ParticleAttributes);
+
+/// Settings from the command line
+struct BenchOptions
+{
+    std::vector<std::string> backends = { "cpu" };
+    std::vector<std::string> scenarios = { "uniform", "cluster", "rain", "galaxy" };
+    std::vector<unsigned int> sizes = { 1000, 10000, 50000 };
+    unsigned int steps = 200;
+    unsigned int threads = 0;
+    std::string out;
+    ForceMode force = ForceMode::BarnesHut;	///< gravity of the galaxy scenario
+    unsigned int reorder = 0;		///< steps between two Morton reorders, 0 never reorders
+    Integrator integrator = Integrator::Euler;
+};
+
+/// Result of one scenario at one particle count
+struct BenchResult
+{
+    std::string backend;
+    std::string scenario;
+    unsigned int particles = 0;
+    unsigned int steps = 0;
+    double particleSteps = 0.0;		///< sum of the live particles over the steps
+    size_t uploadBytes = 0;
+    size_t readbackBytes = 0;
+    std::vector<double> stepTimes;	///< seconds per step
+    uint64_t checksum = 0;			///< of the particles after the last step
+};
+
+/// Split a comma separated list
+static std::vector<std::string> SplitList(const std::string& list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+    {
+        if (!item.empty())
+            items.push_back(item);
+    }
+    return items;
+}
+
+/**
+ * @brief Parse the command line
+ *
+ * @return false on an unknown or incomplete argument
+ */
+static bool ParseOptions(int argc, char** argv, BenchOptions& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            std::cerr << "Missing value for " << arg << std::endl;
+            return false;
+        }
+        std::string value = argv[++i];
+
+        if (arg == "--backend")
+            options.backends = value == "all" ? std::vector<std::string>{ "cpu", "cpu-soa", "gpu" } : SplitList(value);
+        else if (arg == "--scenario")
+            options.scenarios = value == "all" ? std::vector<std::string>{ "uniform", "cluster", "rain", "galaxy" } : SplitList(value);
+        else if (arg == "--sizes")
+        {
+            options.sizes.clear();
+            for (const std::string& size : SplitList(value))
+                options.sizes.push_back((unsigned int)std::strtoul(size.c_str(), nullptr, 10));
+        }
+        else if (arg == "--steps")
+            options.steps = (unsigned int)std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--threads")
+            options.threads = (unsigned int)std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--out")
+            options.out = value;
+        else if (arg == "--reorder")
+            options.reorder = (unsigned int)std::strtoul(value.c_str(), nullptr, 10);
+        else if (arg == "--force" && (value == "barnes-hut" || value == "mesh" || value == "all-pairs"))
+            options.force = value == "mesh" ? ForceMode::ParticleMesh : value == "all-pairs" ? ForceMode::AllPairs : ForceMode::BarnesHut;
+        else if (arg == "--integrator" && (value == "euler" || value == "position-verlet" || value == "velocity-verlet"))
+            options.integrator = value == "position-verlet" ? Integrator::PositionVerlet : value == "velocity-verlet" ? Integrator::VelocityVerlet : Integrator::Euler;
+        else
+        {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return false;
+        }
+    }
+    for (const std::string& backend : options.backends)
+    {
+        if (backend != "cpu" && backend != "cpu-soa" && backend != "gpu")
+        {
+            std::cerr << "Unknown backend " << backend << std::endl;
+            return false;
+        }
+    }
+    for (const std::string& scenario : options.scenarios)
+    {
+        if (scenario != "uniform" && scenario != "cluster" && scenario != "rain" && scenario != "galaxy")
+        {
+            std::cerr << "Unknown scenario " << scenario << std::endl;
+            return false;
+        }
+    }
+    return options.steps > 0;
+}
+
+/**
+ * @brief Fill the particle system with the start state of a scenario
+ *
+ * @param scenario uniform: random over the whole box, cluster: a dense disc in the middle,
+ *                 rain: empty, the particles are emitted by Emit,
+ *                 galaxy: a rotating disc that holds together by the gravity of the --force mode
+ * @param count number of particles
+ * @param random generator with a fixed seed, so every run gets the same particles
+ */
+static void Populate(const std::string& scenario, unsigned int count, ParticleSystem& particlesystem, std::mt19937& random)
+{
+    std::uniform_real_distribution<float> x(BOUNDS_MIN.x + RADIUS, BOUNDS_MAX.x - RADIUS);
+    std::uniform_real_distribution<float> y(BOUNDS_MIN.y + RADIUS, BOUNDS_MAX.y - RADIUS);
+    std::uniform_real_distribution<float> speed(-20.0f, 20.0f);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    glm::vec4 color = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    if (scenario == "uniform")
+    {
+        for (unsigned int i = 0; i < count; i++)
+            particlesystem.CreateParticle({ x(random), y(random), 0.0f }, { speed(random), speed(random), 0.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f, RADIUS, color);
+    }
+    else if (scenario == "cluster")
+    {
+        float discRadius = RADIUS * std::sqrt((float)count) * 1.2f;    ///< about two particles per cell
+        glm::vec2 centre = (BOUNDS_MIN + BOUNDS_MAX) * 0.5f;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            float angle = unit(random) * 6.2831853f;
+            float distance = discRadius * std::sqrt(unit(random));
+            glm::vec2 pos = centre + distance * glm::vec2(std::cos(angle), std::sin(angle));
+            pos = glm::clamp(pos, BOUNDS_MIN + RADIUS, BOUNDS_MAX - RADIUS);
+            particlesystem.CreateParticle({ pos.x, pos.y, 0.0f }, { speed(random), speed(random), 0.0f }, { 0.0f, 0.0f, 0.0f }, 1.0f, RADIUS, color);
+        }
+    }
+    else if (scenario == "galaxy")
+    {
+        // circular orbits around the mass inside the orbit, the disc has a uniform density
+        float mass = GALAXY_MASS / count;
+        glm::vec2 centre = (BOUNDS_MIN + BOUNDS_MAX) * 0.5f;
+        for (unsigned int i = 0; i < count; i++)
+        {
+            float angle = unit(random) * 6.2831853f;
+            float distance = GALAXY_RADIUS * std::sqrt(unit(random));
+            glm::vec2 direction(std::cos(angle), std::sin(angle));
+            glm::vec2 pos = centre + distance * direction;
+            float orbitSpeed = std::sqrt(GALAXY_MASS * distance / (GALAXY_RADIUS * GALAXY_RADIUS));
+            particlesystem.CreateParticle({ pos.x, pos.y, 0.0f }, { -direction.y * orbitSpeed, direction.x * orbitSpeed, 0.0f }, { 0.0f, 0.0f, 0.0f },
+                mass, RADIUS, color);
+        }
+    }
+}
+
+/**
+ * @brief Emit the particles of one step of the rain scenario
+ *
+ * @return unsigned int number of particles created
+ *
+ * @details
+ * The count is spread evenly over the steps, so the last step runs with all particles.
+ */
+static unsigned int Emit(unsigned int step, unsigned int steps, unsigned int count, ParticleSystem& particlesystem, std::mt19937& random)
+{
+    unsigned int target = (unsigned int)((unsigned long long)count * (step + 1) / steps);
+    unsigned int created = 0;
+
+    std::uniform_real_distribution<float> x(BOUNDS_MIN.x + RADIUS, BOUNDS_MAX.x - RADIUS);
+    std::uniform_real_distribution<float> speed(-5.0f, 5.0f);
+    while (particlesystem.size() < target)
+    {
+        particlesystem.CreateParticle({ x(random), BOUNDS_MAX.y - RADIUS, 0.0f }, { speed(random), -50.0f, 0.0f }, { 0.0f, 0.0f, 0.0f },
+            1.0f, RADIUS, { 0.3f, 0.5f, 1.0f, 1.0f });
+        created++;
+    }
+    return created;
+}
+
+/// Seconds since start
+static double Elapsed(const std::chrono::steady_clock::time_point& start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief FNV-1a hash of the particles
+ *
+ * @details
+ * Only the Particle records, the attributes hold fields that a backend does not use.
+ */
+static uint64_t Checksum(const ParticleSystem& particlesystem)
+{
+    const unsigned char* bytes = (const unsigned char*)particlesystem.data();
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < particlesystem.size() * sizeof(Particle); i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/**
+ * @brief Run a scenario on the CpuSimulator
+ *
+ * @param soa update a ParticleSoA gathered from the particle system instead of the particle system
+ *
+ * @details
+ * The particles stay in memory, so nothing is uploaded or read back.
+ * The rain scenario scatters and gathers the ParticleSoA around the emission of a step.
+ */
+static BenchResult RunCpu(const std::string& scenario, unsigned int count, const BenchOptions& options, bool soa)
+{
+    BenchResult result;
+    result.backend = soa ? "cpu-soa" : "cpu";
+    result.scenario = scenario;
+    result.particles = count;
+    result.steps = options.steps;
+
+    std::mt19937 random(1234);
+    ParticleSystem particlesystem;
+    particlesystem.MemorySize(count);
+    particlesystem.InitFreelist();
+    Populate(scenario, count, particlesystem, random);
+
+    CpuSimulator simulator(options.threads);
+    simulator.initGrid(BOUNDS_MIN, BOUNDS_MAX, CELL_SIZE);
+    simulator.SetReorderInterval(options.reorder);
+    simulator.SetIntegrator(options.integrator);
+    if (scenario == "rain")
+        simulator.SetGravity(RAIN_GRAVITY);
+    if (scenario == "galaxy")
+    {
+        simulator.SetForceMode(options.force);
+        simulator.SetGravitation(1.0f, GALAXY_SOFTENING, GALAXY_OPENING_ANGLE);
+    }
+
+    ParticleSoA particles;
+    if (soa)
+        particles.Gather(particlesystem);
+
+    for (unsigned int step = 0; step < options.steps; step++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (scenario == "rain")
+        {
+            if (soa)
+                particles.Scatter(particlesystem);
+            Emit(step, options.steps, count, particlesystem, random);
+            if (soa)
+                particles.Gather(particlesystem);
+        }
+        if (soa)
+            simulator.Update(particles, STEP_SIZE);
+        else
+            simulator.Update(particlesystem, STEP_SIZE);
+        result.stepTimes.push_back(Elapsed(start));
+        result.particleSteps += (double)particlesystem.size();
+    }
+
+    if (soa)
+        particles.Scatter(particlesystem);
+    result.checksum = Checksum(particlesystem);
+    return result;
+}
+
+#ifdef PARTICLE_BENCH_GPU
+/**
+ * @brief Make an offscreen OpenGL 4.5 core context current
+ *
+ * @return false when EGL or the context is not available
+ *
+ * @details
+ * Uses the surfaceless platform when the driver has it, so no display is needed.
+ */
+static bool InitOffscreenContext()
+{
+    EGLDisplay display = EGL_NO_DISPLAY;
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    if (getPlatformDisplay)
+        display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+    if (display == EGL_NO_DISPLAY)
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    EGLint major = 0, minor = 0;
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor) || !eglBindAPI(EGL_OPENGL_API))
+        return false;
+
+    EGLint configAttributes[] = { EGL_SURFACE_TYPE, EGL_PBUFFER_BIT, EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+    EGLConfig config = nullptr;
+    EGLint configs = 0;
+    eglChooseConfig(display, configAttributes, &config, 1, &configs);
+
+    EGLint contextAttributes[] = { EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE };
+    EGLContext context = eglCreateContext(display, configs > 0 ? config : nullptr, EGL_NO_CONTEXT, contextAttributes);
+    if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        return false;
+
+    glewExperimental = GL_TRUE;
+    return glewContextInit() == GLEW_OK;
+}
+
+/**
+ * @brief Run a scenario on the ComputeShader
+ *
+ * @details
+ * Every step ends with glFinish, so the step times are the gpu times and not the time
+ * to queue the commands. The rain particles are uploaded with UploadDirty after they
+ * are emitted and all particles are read back once at the end.
+ */
+static BenchResult RunGpu(const std::string& scenario, unsigned int count, const BenchOptions& options)
+{
+    BenchResult result;
+    result.backend = "gpu";
+    result.scenario = scenario;
+    result.particles = count;
+    result.steps = options.steps;
+
+    std::mt19937 random(1234);
+    ParticleSystem particlesystem;
+    particlesystem.MemorySize(count);
+    particlesystem.InitFreelist();
+    Populate(scenario, count, particlesystem, random);
+
+    ComputeShader computeShader(PARTICLE_BENCH_RES "shaders/ParticleShaders/Compute.glsl");
+    computeShader.SetReadbackMode(ReadbackMode::Synchronous);
+    computeShader.initSSBO(count);
+    computeShader.initGrid(BOUNDS_MIN, BOUNDS_MAX, CELL_SIZE);
+    computeShader.SetReorderInterval(options.reorder);
+    computeShader.SetIntegrator(options.integrator);
+    if (scenario == "rain")
+        computeShader.SetGravity(RAIN_GRAVITY);
+    if (scenario == "galaxy")
+    {
+        computeShader.SetForceMode(options.force);
+        computeShader.SetGravitation(1.0f, GALAXY_SOFTENING, GALAXY_OPENING_ANGLE);
+    }
+    computeShader.UploadData(particlesystem);
+    result.uploadBytes += particlesystem.size() * PARTICLE_BYTES;
+    glFinish();
+
+    for (unsigned int step = 0; step < options.steps; step++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        if (scenario == "rain")
+        {
+            unsigned int created = Emit(step, options.steps, count, particlesystem, random);
+            computeShader.UploadDirty(particlesystem);
+            result.uploadBytes += created * PARTICLE_BYTES;
+        }
+        computeShader.Update(particlesystem, STEP_SIZE);
+        glFinish();
+        result.stepTimes.push_back(Elapsed(start));
+        result.particleSteps += (double)particlesystem.size();
+    }
+
+    computeShader.RetrieveData(particlesystem);
+    result.readbackBytes += particlesystem.size() * PARTICLE_BYTES;
+    result.checksum = Checksum(particlesystem);
+    return result;
+}
+#endif
+
+/// Value at fraction p of the sorted step times
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+    if (sorted.empty())
+        return 0.0;
+    size_t index = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+/**
+ * @brief Write the results as a JSON document
+ *
+ * @details
+ * Times per step are in milliseconds, ns_per_particle_step divides the total time by
+ * the sum of the live particles over the steps.
+ */
+static void WriteJson(std::ostream& out, const std::vector<BenchResult>& results, const BenchOptions& options)
+{
+    out << "{\n";
+    out << "  \"dimension\": " << SIM_DIM << ",\n";
+    out << "  \"step_size\": " << STEP_SIZE << ",\n";
+    out << "  \"threads\": " << options.threads << ",\n";
+    out << "  \"force\": \"" << (options.force == ForceMode::ParticleMesh ? "mesh" : options.force == ForceMode::AllPairs ? "all-pairs" : "barnes-hut") << "\",\n";
+    out << "  \"reorder\": " << options.reorder << ",\n";
+    out << "  \"integrator\": \"" << (options.integrator == Integrator::PositionVerlet ? "position-verlet" : options.integrator == Integrator::VelocityVerlet ? "velocity-verlet" : "euler") << "\",\n";
+    out << "  \"results\": [";
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const BenchResult& result = results[i];
+        std::vector<double> sorted = result.stepTimes;
+        std::sort(sorted.begin(), sorted.end());
+        double seconds = 0.0;
+        for (double time : sorted) { seconds += time; }
+
+        out << (i ? ",\n" : "\n") << "    {";
+        out << "\"backend\": \"" << result.backend << "\", ";
+        out << "\"scenario\": \"" << result.scenario << "\", ";
+        out << "\"particles\": " << result.particles << ", ";
+        out << "\"steps\": " << result.steps << ", ";
+        out << "\"seconds\": " << seconds << ", ";
+        out << "\"steps_per_s\": " << (seconds > 0.0 ? result.steps / seconds : 0.0) << ", ";
+        out << "\"ns_per_particle_step\": " << (result.particleSteps > 0.0 ? seconds * 1e9 / result.particleSteps : 0.0) << ", ";
+        out << "\"upload_bytes\": " << result.uploadBytes << ", ";
+        out << "\"readback_bytes\": " << result.readbackBytes << ", ";
+        out << "\"checksum\": \"" << std::hex << result.checksum << std::dec << "\", ";
+        out << "\"step_ms\": {";
+        out << "\"p50\": " << Percentile(sorted, 0.50) * 1e3 << ", ";
+        out << "\"p90\": " << Percentile(sorted, 0.90) * 1e3 << ", ";
+        out << "\"p99\": " << Percentile(sorted, 0.99) * 1e3 << ", ";
+        out << "\"max\": " << (sorted.empty() ? 0.0 : sorted.back() * 1e3) << "}}";
+    }
+    out << "\n  ]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+    BenchOptions options;
+    if (!ParseOptions(argc, argv, options))
+    {
+        std::cerr << "Usage: particle_bench [--backend cpu|cpu-soa|gpu|all] [--scenario uniform|cluster|rain|galaxy|all] "
+            "[--sizes 1000,10000] [--steps K] [--threads T] [--out file.json] [--force barnes-hut|mesh|all-pairs] [--reorder K] "
+            "[--integrator euler|position-verlet|velocity-verlet]" << std::endl;
+        return 1;
+    }
+
+    bool gpu = std::find(options.backends.begin(), options.backends.end(), "gpu") != options.backends.end();
+#ifdef PARTICLE_BENCH_GPU
+    if (gpu)
+    {
+        if (!InitOffscreenContext())
+        {
+            std::cerr << "No offscreen OpenGL 4.5 context, the gpu backend is skipped." << std::endl;
+            gpu = false;
+        }
+        ProgramCache::SetDirectory(PARTICLE_BENCH_RES "shaders/cache/");
+    }
+#else
+    if (gpu)
+    {
+        std::cerr << "Built without PARTICLE_BENCH_GPU, the gpu backend is skipped." << std::endl;
+        gpu = false;
+    }
+#endif
+
+    std::vector<BenchResult> results;
+    for (const std::string& backend : options.backends)
+    {
+        if (backend == "gpu" && !gpu)
+            continue;
+
+        for (const std::string& scenario : options.scenarios)
+        {
+            for (unsigned int size : options.sizes)
+            {
+                std::cerr << backend << " " << scenario << " " << size << " particles, " << options.steps << " steps" << std::endl;
+#ifdef PARTICLE_BENCH_GPU
+                if (backend == "gpu")
+                {
+                    results.push_back(RunGpu(scenario, size, options));
+                    continue;
+                }
+#endif
+                if (backend == "cpu" || backend == "cpu-soa")
+                    results.push_back(RunCpu(scenario, size, options, backend == "cpu-soa"));
+            }
+        }
+    }
+
+    // a ParticleSoA keeps the order of its Gather, so with reorders the indices differ
+    int status = 0;
+    for (const BenchResult& soa : results)
+    {
+        if (soa.backend != "cpu-soa" || options.reorder != 0)
+            continue;
+        for (const BenchResult& aos : results)
+        {
+            if (aos.backend == "cpu" && aos.scenario == soa.scenario && aos.particles == soa.particles && aos.checksum != soa.checksum)
+            {
+                std::cerr << "cpu-soa differs from cpu: " << soa.scenario << " " << soa.particles << " particles" << std::endl;
+                status = 2;
+            }
+        }
+    }
+
+    if (options.out.empty())
+    {
+        WriteJson(std::cout, results, options);
+    }
+    else
+    {
+        std::ofstream file(options.out);
+        WriteJson(file, results, options);
+    }
+    return status;
+}
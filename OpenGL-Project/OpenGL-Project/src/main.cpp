@@ -36,6 +36,8 @@
 #include "VertexArray.h"
 #include "Shader.h"
 #include "Texture.h"
+#include "FixedTimestep.h"
+#include "GpuProfiler.h"
 
 #include "tests/TestClearColor.h"
 #include "tests/TestTexture2D.h"
@@ -58,6 +60,9 @@ int main(void)
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#if GL_DEBUG_MODE == GL_DEBUG_SYNC
+    glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);    ///< release builds keep a normal context, the driver does less validation
+#endif
 
     /* Create a windowed mode window and its OpenGL context */
     window = glfwCreateWindow(WINDOW_SIZE_X, WINDOW_SIZE_Y, "Particle Simulation", NULL, NULL);
@@ -88,6 +93,8 @@ int main(void)
     if (glewInit() != GLEW_OK)
         std::cout << "Error" << std::endl;
 
+    GlInitDebugOutput();
+
     std::cout << glGetString(GL_VERSION) << std::endl;
     {
 
@@ -105,8 +112,17 @@ int main(void)
         testMenu->RegisterTest<test::TestCircle>("Circle");
         testMenu->RegisterTest<test::TestParticles>("Particles");
 
+        GpuProfiler profiler;
+        FixedTimestep timestep(0.01f, 8);   ///< 100 steps per simulated second, at most 8 per frame
+        double lastTime = glfwGetTime();
+
         while (!glfwWindowShouldClose(window))
         {
+            double now = glfwGetTime();
+            unsigned int steps = timestep.Advance((float)(now - lastTime));
+            lastTime = now;
+            profiler.BeginFrame();
+
             GLCall(glClearColor(0.0f, 0.0f, 0.0f, 1.0f));
             renderer.Clear();
 
@@ -116,7 +132,8 @@ int main(void)
 
             if (currentTest)
             {
-                currentTest->OnUpdate(0.01f);
+                currentTest->SetProfiler(&profiler);
+                currentTest->OnFixedUpdate(timestep.GetStepSize(), steps);
                 currentTest->OnRender();
                 ImGui::Begin("Test");
                 if (currentTest != testMenu && ImGui::Button("<-"))
@@ -133,7 +150,10 @@ int main(void)
             glfwGetFramebufferSize(window, &display_w, &display_h);
             glViewport(0, 0, display_w, display_h);
 
-            ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            {
+                ProfileScope scope(&profiler, "ImGui");
+                ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+            }
 
             glfwSwapBuffers(window);
             glfwPollEvents();
@@ -14,12 +14,16 @@
 #include "TestParticles.h"
 
 #include "Renderer.h"
+#include "GpuProfiler.h"
 #include "imgui/imgui.h"
 
 #include "glm/glm.hpp"
 #include "glm/gtc/matrix_transform.hpp"
 
+#include <cstdlib>
+
 #define NUMBER 32
+#define TUNE_PARTICLES 20000u
 
 // temp values.
 glm::vec3 position = { 400.0f, 300.0f, 0.0f };
@@ -57,14 +61,31 @@ namespace test {
         std::cout << "Start Particle Test" << std::endl;
 
         m_Shader        = std::make_unique<Shader>("res/shaders/ParticleShaders/Vertex.glsl", "res/shaders/ParticleShaders/Fragment.glsl");
+        m_SpriteShader  = std::make_unique<Shader>("res/shaders/ParticleShaders/SpriteVertex.glsl", "res/shaders/ParticleShaders/SpriteFragment.glsl");
         m_ComputeShader = std::make_unique<ComputeShader>("res/shaders/ParticleShaders/Compute.glsl");
 
         m_ComputeShader->initSSBO(m_Particlesystem.GetMaxNumber());
         m_ComputeShader->initSSBOActiveIDlist(m_Particlesystem.GetMaxNumber());
+        m_ComputeShader->initGrid({ -0.5f, -0.5f }, { 800.0f, 600.0f }, 2.0f * radius);   ///< cell size is the particle diameter
+
+        {
+            ParticleSystem sample;      ///< particles spread over the screen to time the workgroup sizes with
+            sample.MemorySize(std::min(TUNE_PARTICLES, m_Particlesystem.GetMaxNumber()));
+            sample.InitFreelist();
+            for (unsigned int i = 0; i < sample.GetMaxNumber(); i++)
+            {
+                glm::vec3 pos = { (float)(std::rand() % 800), (float)(std::rand() % 600), 0.0f };
+                sample.CreateParticle(pos, velocity, accelleration, mass, radius, color);
+            }
+            m_ComputeShader->AutoTuneWorkgroupSize(sample, "res/shaders/ParticleShaders/workgroup.cache");
+        }
 
         m_Particlesystem.InitFreelist();
 
+        m_ComputeShader->SetReadbackMode(ReadbackMode::OnDemand);   ///< particles stay on the gpu, read back on request, Update marks them gpu resident
+
         std::cout << "size of Particle class: " << sizeof(Particle) << std::endl;
+        std::cout << "size of ParticleAttributes class: " << sizeof(ParticleAttributes) << std::endl;
         std::cout << "Maximum amount of particles: " << m_Particlesystem.GetMaxNumber() << std::endl;
         memorySize = m_Particlesystem.GetMaxNumber();
 
@@ -141,19 +162,50 @@ namespace test {
 
     void TestParticles::OnUpdate(float deltaTime)
     {
-        if (m_Particlesystem.GetParticleCount() != 0)
-        {
-            m_ComputeShader->Update(m_Particlesystem, deltaTime);
-            m_ComputeShader->RetrieveData(m_Particlesystem);  // alleen doen wanneer nodig, ipv bij elke dispatch van de computeshader
-            m_TimeElapsed += deltaTime;
-        }
+        OnFixedUpdate(deltaTime, 1);
+    }
+
+    /**
+     * @brief This method runs the fixed steps of one frame.
+     * 
+     * @param stepSize The simulated time of one step.
+     * @param steps The number of steps, can be 0 when the frame was shorter than a step.
+     * 
+     * @details
+     * All steps go to the gpu as one batch of dispatches, without readback in between.
+     * This method is called every frame.
+     */
+    void TestParticles::OnFixedUpdate(float stepSize, unsigned int steps)
+    {
+        m_ComputeShader->SetProfiler(m_Profiler);
 
-        if (flag)
+        if (flag)   ///< spawn before the update, so the new particle is in the render stream
         {
             int freeindex = m_Particlesystem.CreateParticle(position, velocity, accelleration, mass, radius, color);
-            m_ComputeShader->UploadData(m_Particlesystem);
+            m_ComputeShader->UploadDirty(m_Particlesystem);
             nr++;
         }
+
+        if (m_Particlesystem.GetParticleCount() != 0 && steps > 0)
+        {
+            m_ComputeShader->Update(m_Particlesystem, stepSize, steps);
+            m_TimeElapsed += stepSize * steps;
+        }
+
+        if (m_Readback.frame != ReadbackHandle::INVALID_FRAME)
+        {
+            ReadbackStatus status = m_ComputeShader->PollReadback(m_Readback);
+            if (status == ReadbackStatus::Ready)
+            {
+                m_ReadbackCount = m_ComputeShader->ReadReadback(m_Readback, m_Particlesystem) ? (int)m_Particlesystem.size() : -1;
+                m_Readback = ReadbackHandle();
+            }
+            else if (status == ReadbackStatus::Expired)
+            {
+                m_ReadbackCount = -1;
+                m_Readback = ReadbackHandle();
+            }
+        }
     }
     
     /**
@@ -169,18 +221,29 @@ namespace test {
 
         Renderer renderer;
         {
-            m_Shader->Bind();
+            Shader& shader = m_DrawMode == ParticleDrawMode::Mesh ? *m_Shader : *m_SpriteShader;
+            shader.Bind();
 
             glm::mat4 view = glm::mat4(1.0f);
             glm::mat4 projection = glm::ortho(0.0f, 800.0f, 0.0f, 600.0f);  
 
-            m_Shader->SetUniformMat4f("view", view);
-            m_Shader->SetUniformMat4f("projection", projection);
+            shader.SetUniformMat4f("view", view);
+            shader.SetUniformMat4f("projection", projection);
+            m_ComputeShader->BindRenderStream();
+
+            if (m_DrawMode != ParticleDrawMode::Mesh)
+            {
+                GLint viewport[4];
+                GLCall(glGetIntegerv(GL_VIEWPORT, viewport));
+                shader.SetUniform1i("pointSprite", m_DrawMode == ParticleDrawMode::Point ? 1 : 0);
+                shader.SetUniform1f("pointScale", viewport[3] / 600.0f);    ///< pixels per unit of the projection
+            }
 
             //renderer.Draw(*m_VAO, *m_IndexBuffer, *m_Shader);   ///< *m_VAO en *m_IndexBuffer zijn placeholder.
-            renderer.DrawInstanced(*m_VAO, *m_IndexBuffer, *m_Shader, m_Particlesystem.GetParticleCount());
+            ProfileScope scope(m_Profiler, "Draw");
+            renderer.DrawParticles(m_DrawMode, *m_VAO, *m_IndexBuffer, shader, m_Particlesystem.GetParticleCount());
 
-            m_Shader->Unbind();
+            shader.Unbind();
         }
     }
 
@@ -196,27 +259,63 @@ namespace test {
         ImGui::Text("Application average %.3f ms/frame (%.1f FPS)", 1000.0f / ImGui::GetIO().Framerate, ImGui::GetIO().Framerate);
         ImGui::Text("Total time elapsed:%.3f", m_TimeElapsed);
         
-        if (ImGui::Button("Create Particle"))
+        int drawMode = (int)m_DrawMode;
+        ImGui::RadioButton("Mesh", &drawMode, (int)ParticleDrawMode::Mesh); ImGui::SameLine();
+        ImGui::RadioButton("Quad", &drawMode, (int)ParticleDrawMode::Quad); ImGui::SameLine();
+        ImGui::RadioButton("Point", &drawMode, (int)ParticleDrawMode::Point);
+        m_DrawMode = (ParticleDrawMode)drawMode;
+
+        int integrator = (int)m_ComputeShader->GetIntegrator();
+        ImGui::RadioButton("Euler", &integrator, (int)Integrator::Euler); ImGui::SameLine();
+        ImGui::RadioButton("Position Verlet", &integrator, (int)Integrator::PositionVerlet); ImGui::SameLine();
+        ImGui::RadioButton("Velocity Verlet", &integrator, (int)Integrator::VelocityVerlet);
+        m_ComputeShader->SetIntegrator((Integrator)integrator);
+
+        SimParams params = m_ComputeShader->GetParams();
+        ImGui::SliderFloat2("Gravity", &params.gravity.x, -500.0f, 500.0f);
+        ImGui::SliderFloat("Wall friction", &params.frictionW, 0.0f, 1.0f);
+        ImGui::SliderFloat("Particle friction", &params.frictionP, 0.0f, 1.0f);
+        m_ComputeShader->SetGravity(glm::vec3(params.gravity));
+        m_ComputeShader->SetFriction(params.frictionW, params.frictionP);
+
+        int forceMode = (int)m_ComputeShader->GetForceMode();
+        ImGui::RadioButton("No forces", &forceMode, (int)ForceMode::None); ImGui::SameLine();
+        ImGui::RadioButton("Barnes-Hut gravity", &forceMode, (int)ForceMode::BarnesHut); ImGui::SameLine();
+        ImGui::RadioButton("Particle mesh", &forceMode, (int)ForceMode::ParticleMesh); ImGui::SameLine();
+        ImGui::RadioButton("All pairs", &forceMode, (int)ForceMode::AllPairs);
+        m_ComputeShader->SetForceMode((ForceMode)forceMode);
+        if (m_ComputeShader->GetForceMode() != ForceMode::None)
         {
-            int freeindex = m_Particlesystem.CreateParticle(position, velocity, accelleration, mass, radius, color);
-            
-            ///< op dit moment overwrite dit de preallocated memory van initSSBO()
-            m_ComputeShader->UploadData(m_Particlesystem);          
+            ImGui::SliderFloat("G", &params.gravityConstant, 0.0f, 1000.0f);
+            ImGui::SliderFloat("Softening", &params.softening, 0.01f, 20.0f);
+            ImGui::SliderFloat("Opening angle", &params.openingAngle, 0.0f, 1.5f);
+            m_ComputeShader->SetGravitation(params.gravityConstant, params.softening, params.openingAngle);
+
+            int meshExponent = 0;
+            while ((2u << meshExponent) <= m_ComputeShader->GetMeshSize())
+                meshExponent++;
+            int maxExponent = 0;
+            while ((2u << maxExponent) <= ParticleMesh::MAX_CELLS)
+                maxExponent++;
+            if (m_ComputeShader->GetForceMode() == ForceMode::ParticleMesh && ImGui::SliderInt("Mesh cells", &meshExponent, 1, maxExponent, "2^%d"))
+                m_ComputeShader->SetMeshSize(1u << meshExponent);
+        }
 
-            ///< Werkt grotendeels, maar moet handmatig memory updated
-            //unsigned int NewestID = m_Particlesystem.ReturnVectorSize()-1;
-            //Particle newParticle = m_Particlesystem.ReturnParticle(NewestID); 
-            //m_ComputeShader->UploadAddElement(m_Particlesystem, newParticle, NewestID);
+        int reorderInterval = (int)m_ComputeShader->GetReorderInterval();
+        if (ImGui::SliderInt("Reorder interval", &reorderInterval, 0, 600, reorderInterval == 0 ? "off" : "%d steps"))
+            m_ComputeShader->SetReorderInterval((unsigned int)reorderInterval);
 
-            ///< Werkt niet
-            //m_ComputeShader->UploadIDlist(m_Particlesystem.IDlistData());     
+        if (ImGui::Button("Create Particle"))
+        {
+            int freeindex = m_Particlesystem.CreateParticle(position, velocity, accelleration, mass, radius, color);
+            m_ComputeShader->UploadDirty(m_Particlesystem);         ///< only the new particle is uploaded
         }
 
         ImGui::InputInt("Particle ID", &particleID);
         if (ImGui::Button("Remove Particle"))
         {
             m_Particlesystem.DestroyParticle(particleID);
-            m_ComputeShader->UploadData(m_Particlesystem);          ///< op dit moment overwrite dit de preallocated memory van initSSBO()
+            m_ComputeShader->UploadDirty(m_Particlesystem);         ///< only the particle moved into the gap is uploaded
         }
 
         ImGui::Text("Mouse Clicked at: (%.3f,%.3f)", mousePos.x, mousePos.y);
@@ -233,7 +332,7 @@ namespace test {
                 glm::vec3 MouseClick = { mousePos.x, invertedY, 0.0 };
 
                 int freeindex = m_Particlesystem.CreateParticle(MouseClick, velocity, accelleration, mass, radius, color);
-                m_ComputeShader->UploadData(m_Particlesystem);
+                m_ComputeShader->UploadDirty(m_Particlesystem);
             }
         }
 
@@ -247,10 +346,24 @@ namespace test {
         if (ImGui::Button("Update Memory Pool"))
         {
             m_Particlesystem.MemorySize(memorySize);
-            std::cout << "updated Memory pool to " << memorySize << std::endl;
-            m_ComputeShader->initSSBO(m_Particlesystem.GetMaxNumber());   // reallocate memory on gpu
-            m_ComputeShader->UploadData(m_Particlesystem);                // upload data to gpu.
+            std::cout << "updated Memory pool to " << m_Particlesystem.GetMaxNumber() << std::endl;
+            m_ComputeShader->Reserve(m_Particlesystem);                   // grow the gpu buffers, the particles are copied on the gpu
+        }
+
+        if (ImGui::Button("Read back Particles"))
+        {
+            if (m_ComputeShader->GetReadbackMode() == ReadbackMode::OnDemand)
+                m_Readback = m_ComputeShader->RequestReadback(m_Particlesystem);
+            else
+            {
+                m_ComputeShader->RetrieveData(m_Particlesystem);
+                m_ReadbackCount = (int)m_Particlesystem.size();
+            }
         }
+        ImGui::SameLine();
+        if (m_Readback.frame != ReadbackHandle::INVALID_FRAME) { ImGui::Text("pending"); }
+        else if (m_ReadbackCount < 0) { ImGui::Text("failed, request again"); }
+        else { ImGui::Text("%d particles on the cpu", m_ReadbackCount); }
 
         //ImGui::Text("Total Energy in system: %.3fJ", 999.999f); ///< method maken voor berekenen totale kinetische energie.
 
@@ -266,6 +379,9 @@ namespace test {
             else { flag_m = 0; }
         }
 
+        if (m_Profiler && ImGui::CollapsingHeader("Profiler"))
+            m_Profiler->OnImGuiRender();
+
 
     }
 
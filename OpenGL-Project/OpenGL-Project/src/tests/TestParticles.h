@@ -47,6 +47,7 @@ namespace test {
 		~TestParticles();
 
 		void OnUpdate(float delatTime) override;
+		void OnFixedUpdate(float stepSize, unsigned int steps) override;
 		void OnRender() override;
 		void OnImGuiRender() override;	
 
@@ -57,10 +58,16 @@ namespace test {
 		std::unique_ptr<VertexBuffer> m_VertexBuffer;
 		std::unique_ptr<IndexBuffer> m_IndexBuffer;
 		std::unique_ptr<Shader> m_Shader;
+		std::unique_ptr<Shader> m_SpriteShader;		///< quad and point sprite shader
 		std::unique_ptr<ComputeShader> m_ComputeShader;
 
 		ParticleSystem m_Particlesystem;
 
+		ParticleDrawMode m_DrawMode = ParticleDrawMode::Quad;
+
+		ReadbackHandle m_Readback;		///< pending snapshot request
+		int m_ReadbackCount = 0;		///< particles in the last snapshot, -1 when it failed
+
 	};
 
 }
\ No newline at end of file
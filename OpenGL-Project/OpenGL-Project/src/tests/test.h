@@ -18,6 +18,8 @@
 #include <functional> 
 #include <iostream>
 
+class GpuProfiler;
+
 /**
  * @brief The test namespace contains the Test class and its methods.
  * 
@@ -32,6 +34,9 @@ namespace test {
 	 * 
 	 * @details
 	 * The Test class is a virtual class that is used to create tests.
+	 * The main loop calls OnFixedUpdate once per frame with the number of fixed steps
+	 * to simulate, by default that calls OnUpdate once per step. Tests that can
+	 * batch the steps override OnFixedUpdate.
 	 */
 	class Test
 	{
@@ -40,8 +45,14 @@ namespace test {
 		virtual ~Test() {}
 
 		virtual void OnUpdate(float deltaTime) {}
+		virtual void OnFixedUpdate(float stepSize, unsigned int steps) { for (unsigned int i = 0; i < steps; i++) { OnUpdate(stepSize); } }
 		virtual void OnRender() {}
 		virtual void OnImGuiRender() {}
+
+		void SetProfiler(GpuProfiler* profiler) { m_Profiler = profiler; }
+
+	protected:
+		GpuProfiler* m_Profiler = nullptr;	///< frame profiler of main, times the stages of the test
 	};
 
 	/**